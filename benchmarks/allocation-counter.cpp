@@ -0,0 +1,205 @@
+#include "allocation-counter.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// The replacements live in a translation unit of their own, and cover every
+// form of new and delete, so that the compiler never sees a delete of ours
+// paired with a new it did not inline, and all memory goes through one
+// allocator: malloc.
+
+namespace {
+
+thread_local bool tCounting {false};
+std::atomic<std::size_t> gAllocations {0};
+
+void* Allocate(std::size_t size) noexcept
+{
+    if (tCounting) {
+        gAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+// Over-allocate and keep the pointer that malloc returned just before the
+// aligned block, where Deallocate() finds it.
+void* AllocateAligned(std::size_t size, std::align_val_t alignment) noexcept
+{
+    const auto align {static_cast<std::size_t>(alignment)};
+    void* raw {Allocate(size + align + sizeof(void*))};
+    if (raw == nullptr) {
+        return nullptr;
+    }
+    auto address {reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*)};
+    address = (address + align - 1) / align * align;
+    reinterpret_cast<void**>(address)[-1] = raw;
+    return reinterpret_cast<void*>(address);
+}
+
+void DeallocateAligned(void* ptr) noexcept
+{
+    if (ptr != nullptr) {
+        std::free(static_cast<void**>(ptr)[-1]);
+    }
+}
+
+void* AllocateOrThrow(std::size_t size)
+{
+    if (void* ptr = Allocate(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc {};
+}
+
+void* AllocateAlignedOrThrow(std::size_t size, std::align_val_t alignment)
+{
+    if (void* ptr = AllocateAligned(size, alignment)) {
+        return ptr;
+    }
+    throw std::bad_alloc {};
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    return AllocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return AllocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return AllocateAlignedOrThrow(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return AllocateAlignedOrThrow(size, alignment);
+}
+
+void* operator new(
+    std::size_t size,
+    std::align_val_t alignment,
+    const std::nothrow_t&
+) noexcept
+{
+    return AllocateAligned(size, alignment);
+}
+
+void* operator new[](
+    std::size_t size,
+    std::align_val_t alignment,
+    const std::nothrow_t&
+) noexcept
+{
+    return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    DeallocateAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    DeallocateAligned(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    DeallocateAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    DeallocateAligned(ptr);
+}
+
+void operator delete(
+    void* ptr,
+    std::align_val_t,
+    const std::nothrow_t&
+) noexcept
+{
+    DeallocateAligned(ptr);
+}
+
+void operator delete[](
+    void* ptr,
+    std::align_val_t,
+    const std::nothrow_t&
+) noexcept
+{
+    DeallocateAligned(ptr);
+}
+
+namespace NetworkMonitor {
+
+ScopedAllocationCount::ScopedAllocationCount()
+    : wasCounting_ {tCounting}
+{
+    tCounting = true;
+}
+
+ScopedAllocationCount::~ScopedAllocationCount()
+{
+    tCounting = wasCounting_;
+}
+
+std::size_t GetAllocationCount()
+{
+    return gAllocations.load(std::memory_order_relaxed);
+}
+
+void ResetAllocationCount()
+{
+    gAllocations.store(0, std::memory_order_relaxed);
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,36 @@
+#ifndef NETWORK_MONITOR_ALLOCATION_COUNTER_H
+#define NETWORK_MONITOR_ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+namespace NetworkMonitor {
+
+/*! \brief Count the heap allocations made on this thread while it lives.
+ *
+ *  Benchmarks that use it link allocation-counter.cpp, which replaces the
+ *  global allocation functions. The count is shared by all the threads
+ *  that count: see GetAllocationCount().
+ */
+class ScopedAllocationCount {
+public:
+    ScopedAllocationCount();
+    ~ScopedAllocationCount();
+
+    ScopedAllocationCount(const ScopedAllocationCount&) = delete;
+    ScopedAllocationCount& operator=(const ScopedAllocationCount&) = delete;
+
+private:
+    bool wasCounting_;
+};
+
+/*! \brief Number of allocations counted since the last reset.
+ */
+std::size_t GetAllocationCount();
+
+/*! \brief Set the allocation count back to zero.
+ */
+void ResetAllocationCount();
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_ALLOCATION_COUNTER_H
@@ -0,0 +1,283 @@
+#include "compression-options.h"
+#include "loopback-server.h"
+#include "websocket-client.h"
+
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NetworkMonitor::CompressionOptions;
+using NetworkMonitor::LoopbackMode;
+using NetworkMonitor::LoopbackServer;
+using NetworkMonitor::LoopbackServerOptions;
+using NetworkMonitor::WebSocketClient;
+using NetworkMonitor::WebSocketClientOptions;
+using NetworkMonitor::WebSocketClientStats;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Frames shaped like the live feed: STOMP headers around a small JSON event.
+std::vector<std::string> MakeMessages(std::size_t nMessages)
+{
+    std::mt19937 rng {42};
+    std::uniform_int_distribution<int> station(0, 425);
+    std::uniform_int_distribution<int> route(0, 95);
+    std::uniform_int_distribution<int> kind(0, 3);
+    std::vector<std::string> messages {};
+    char body[256];
+    for (std::size_t idx {0}; idx < nMessages; ++idx) {
+        int size {0};
+        switch (kind(rng)) {
+        case 0:
+        case 1:
+            size = std::snprintf(body, sizeof(body),
+                "{\"datetime\":\"2026-10-17T07:%02d:%02d.000Z\","
+                "\"passenger_event\":\"%s\",\"station_id\":\"station_%03d\"}",
+                static_cast<int>(idx / 60 % 60), static_cast<int>(idx % 60),
+                idx % 2 ? "in" : "out", station(rng));
+            break;
+        default:
+            size = std::snprintf(body, sizeof(body),
+                "{\"datetime\":\"2026-10-17T07:%02d:%02d.000Z\","
+                "\"train_event\":\"departure\",\"route_id\":\"route_%03d\","
+                "\"station_id\":\"station_%03d\",\"passengers\":%d}",
+                static_cast<int>(idx / 60 % 60), static_cast<int>(idx % 60),
+                route(rng), station(rng), static_cast<int>(idx % 300));
+            break;
+        }
+        std::string message {"MESSAGE\ndestination:/network-events\n"
+                             "content-type:application/json\n"
+                             "subscription:0\nmessage-id:"};
+        message += std::to_string(idx);
+        message += "\ncontent-length:";
+        message += std::to_string(size);
+        message += "\n\n";
+        message.append(body, static_cast<std::size_t>(size));
+        message += '\0';
+        messages.push_back(std::move(message));
+    }
+    return messages;
+}
+
+struct Setting {
+    const char* name;
+    CompressionOptions compression;
+};
+
+std::vector<Setting> MakeSettings()
+{
+    std::vector<Setting> settings {};
+    settings.push_back({"off", {}});
+
+    CompressionOptions deflate {};
+    deflate.enabled = true;
+    settings.push_back({"deflate", deflate});
+
+    auto fast {deflate};
+    fast.level = 1;
+    settings.push_back({"deflate level 1", fast});
+
+    auto small {deflate};
+    small.clientMaxWindowBits = 9;
+    small.serverMaxWindowBits = 9;
+    small.memoryLevel = 1;
+    settings.push_back({"deflate 512 B window", small});
+
+    auto isolated {deflate};
+    isolated.clientNoContextTakeover = true;
+    isolated.serverNoContextTakeover = true;
+    settings.push_back({"deflate no takeover", isolated});
+    return settings;
+}
+
+struct Result {
+    double seconds {0};
+    double processCpuSeconds {0};
+    WebSocketClientStats stats {};
+};
+
+// Connections echo nMessages each through an in-process server, with up to
+// `window` messages in flight.
+bool Run(
+    const CompressionOptions& compression,
+    const std::vector<std::string>& messages,
+    std::size_t nConnections,
+    std::size_t nMessages,
+    std::size_t window,
+    Result& result
+)
+{
+    boost::asio::io_context serverIoc {};
+    LoopbackServerOptions serverOptions {};
+    serverOptions.mode = LoopbackMode::Echo;
+    serverOptions.compression = compression;
+    LoopbackServer server {serverIoc, serverOptions};
+    boost::system::error_code ec {};
+    server.Start(ec);
+    if (ec) {
+        std::cerr << "Could not start the server: " << ec.message()
+                  << std::endl;
+        return false;
+    }
+    std::thread serverThread {[&serverIoc]() { serverIoc.run(); }};
+
+    boost::asio::io_context clientIoc {1};
+    auto clientGuard {boost::asio::make_work_guard(clientIoc)};
+    std::thread clientThread {[&clientIoc]() { clientIoc.run(); }};
+
+    WebSocketClientOptions options {};
+    options.compression = compression;
+    options.cpuStats = true;
+    std::atomic<std::size_t> nConnected {0};
+    std::atomic<std::size_t> nDone {0};
+    std::vector<std::unique_ptr<WebSocketClient>> clients {};
+    std::vector<std::size_t> nSent(nConnections, 0);
+    std::vector<std::size_t> nReceived(nConnections, 0);
+    for (std::size_t idx {0}; idx < nConnections; ++idx) {
+        clients.push_back(std::make_unique<WebSocketClient>(
+            "127.0.0.1", "/", std::to_string(server.GetPort()), clientIoc,
+            options
+        ));
+        auto& client {*clients.back()};
+        auto& sent {nSent[idx]};
+        auto& received {nReceived[idx]};
+        client.ConnectView(
+            [&nConnected](auto ec) {
+                if (!ec) {
+                    ++nConnected;
+                }
+            },
+            [&, nMessages](auto /*ec*/, auto /*message*/) {
+                if (++received == nMessages) {
+                    ++nDone;
+                }
+                if (sent < nMessages) {
+                    client.Send(messages[sent++ % messages.size()]);
+                }
+            }
+        );
+    }
+
+    const auto wait = [](auto&& done) {
+        const auto deadline {Clock::now() + std::chrono::seconds {60}};
+        while (!done() && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds {1});
+        }
+        return done();
+    };
+    bool ok {wait([&]() { return nConnected == nConnections; })};
+
+    const auto cpuStart {std::clock()};
+    const auto start {Clock::now()};
+    if (ok) {
+        // The client io_context has a single thread, so this does not race
+        // with the message callbacks over the counts.
+        for (std::size_t idx {0}; idx < nConnections; ++idx) {
+            boost::asio::post(clientIoc, [&, idx]() {
+                for (; nSent[idx] < window && nSent[idx] < nMessages;
+                     ++nSent[idx]) {
+                    clients[idx]->Send(messages[nSent[idx] % messages.size()]);
+                }
+            });
+        }
+        ok = wait([&]() { return nDone == nConnections; });
+    }
+    result.seconds = std::chrono::duration<double>(
+        Clock::now() - start
+    ).count();
+    result.processCpuSeconds =
+        static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    // The wire counts include the HTTP upgrade, a few hundred bytes per
+    // connection.
+    result.stats = {};
+    for (const auto& client: clients) {
+        const auto stats {client->GetStats()};
+        result.stats.rawBytesSent += stats.rawBytesSent;
+        result.stats.rawBytesReceived += stats.rawBytesReceived;
+        result.stats.wireBytesSent += stats.wireBytesSent;
+        result.stats.wireBytesReceived += stats.wireBytesReceived;
+        result.stats.messagesReceived += stats.messagesReceived;
+        result.stats.cpuTime += stats.cpuTime;
+    }
+
+    for (auto& client: clients) {
+        client->Close();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds {100});
+    server.Stop();
+    clientGuard.reset();
+    clientIoc.stop();
+    clientThread.join();
+    serverIoc.stop();
+    serverThread.join();
+    return ok;
+}
+
+} // namespace
+
+/* Echoes feed-like messages through an in-process server with several
+   permessage-deflate settings, and reports the bytes on the wire against the
+   CPU time they cost.
+
+   Client CPU is what WebSocketClientStats measures: framing and compression
+   on the client side. Process CPU adds the server, which compresses too, and
+   the rest of the machinery.
+
+   Usage: compression-bench [n-connections] [n-messages] [window] */
+int main(int argc, char* argv[])
+{
+    const std::size_t nConnections {argc > 1 ? std::stoul(argv[1]) : 4};
+    const std::size_t nMessages {argc > 2 ? std::stoul(argv[2]) : 20000};
+    const std::size_t window {argc > 3 ? std::stoul(argv[3]) : 16};
+    const auto messages {MakeMessages(4096)};
+
+    std::cout << nConnections << " connections, " << nMessages
+              << " feed messages each, window " << window << std::endl;
+    std::cout << std::left << std::setw(22) << "setting" << std::right
+              << std::setw(10) << "msg/s"
+              << std::setw(12) << "raw MB"
+              << std::setw(12) << "wire MB"
+              << std::setw(8) << "ratio"
+              << std::setw(16) << "client us/msg"
+              << std::setw(17) << "process us/msg" << std::endl;
+    std::cout << std::fixed;
+    for (const auto& setting: MakeSettings()) {
+        Result result {};
+        if (!Run(setting.compression, messages, nConnections, nMessages,
+                 window, result)) {
+            std::cerr << setting.name << ": the run did not complete"
+                      << std::endl;
+            return 1;
+        }
+        const auto& stats {result.stats};
+        const auto nTotal {static_cast<double>(stats.messagesReceived)};
+        const auto raw {static_cast<double>(stats.rawBytesSent +
+                                            stats.rawBytesReceived)};
+        const auto wire {static_cast<double>(stats.wireBytesSent +
+                                             stats.wireBytesReceived)};
+        std::cout << std::left << std::setw(22) << setting.name << std::right
+                  << std::setprecision(0)
+                  << std::setw(10) << nTotal / result.seconds
+                  << std::setprecision(2)
+                  << std::setw(12) << raw / 1e6
+                  << std::setw(12) << wire / 1e6
+                  << std::setw(8) << raw / wire
+                  << std::setw(16) << stats.cpuTime.count() / 1e3 / nTotal
+                  << std::setw(17)
+                  << result.processCpuSeconds * 1e6 / nTotal << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "connection-pool.h"
+#include "loopback-server.h"
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NetworkMonitor::ConnectionPool;
+using NetworkMonitor::ConnectionPoolOptions;
+using NetworkMonitor::LoopbackMode;
+using NetworkMonitor::LoopbackServer;
+using NetworkMonitor::LoopbackServerOptions;
+using NetworkMonitor::PooledMessage;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+/* Reports how many messages per second a ConnectionPool funnels to its
+   consumer as the number of worker threads grows. The messages come from an
+   in-process server on the loopback interface.
+
+   Usage: connection-pool-bench [n-connections] [n-messages-per-connection]
+                                [max-threads] [message-bytes] */
+int main(int argc, char* argv[])
+{
+    const std::size_t nConnections {
+        argc > 1 ? std::stoul(argv[1]) : std::size_t {64}
+    };
+    const std::size_t nMessages {
+        argc > 2 ? std::stoul(argv[2]) : std::size_t {20000}
+    };
+    const std::size_t maxThreads {argc > 3 ? std::stoul(argv[3]) :
+        std::max(1u, std::thread::hardware_concurrency())
+    };
+    const std::size_t messageBytes {
+        argc > 4 ? std::stoul(argv[4]) : std::size_t {256}
+    };
+
+    // The server gets its own threads so that it does not compete with the
+    // pool for the io_context.
+    boost::asio::io_context serverIoc {};
+    LoopbackServerOptions serverOptions {};
+    serverOptions.mode = LoopbackMode::Flood;
+    serverOptions.messageBytes = messageBytes;
+    serverOptions.nMessages = nMessages;
+    LoopbackServer server {serverIoc, serverOptions};
+    boost::system::error_code ec {};
+    server.Start(ec);
+    if (ec) {
+        std::cerr << "Could not start the server: " << ec.message()
+                  << std::endl;
+        return 1;
+    }
+    const auto port {std::to_string(server.GetPort())};
+    auto serverGuard {boost::asio::make_work_guard(serverIoc)};
+    std::vector<std::thread> serverThreads {};
+    for (std::size_t idx {0}; idx < std::max<std::size_t>(1, maxThreads / 2);
+         ++idx) {
+        serverThreads.emplace_back([&serverIoc]() { serverIoc.run(); });
+    }
+
+    std::cout << nConnections << " connections x " << nMessages
+              << " messages of " << messageBytes << " bytes" << std::endl;
+    std::cout << "threads  contexts      messages/s        MB/s     dropped" << std::endl;
+    const auto total {nConnections * nMessages};
+    bool ok {true};
+    for (std::size_t nThreads {1}; nThreads <= maxThreads; nThreads *= 2) {
+        for (const bool perThread: {false, true}) {
+            if (perThread && nThreads == 1) {
+                continue;
+            }
+            ConnectionPoolOptions options {};
+            options.nThreads = nThreads;
+            options.ioContextPerThread = perThread;
+            ConnectionPool pool {options};
+
+            const auto start {Clock::now()};
+            for (std::size_t idx {0}; idx < nConnections; ++idx) {
+                pool.AddConnection("127.0.0.1", "/", port);
+            }
+            // Messages the consumer was too slow for are dropped, not lost.
+            std::size_t nReceived {0};
+            PooledMessage message {};
+            while (nReceived + pool.GetDroppedCount() < total) {
+                if (!pool.Pop(message, std::chrono::seconds {5})) {
+                    break;
+                }
+                ++nReceived;
+            }
+            const auto elapsed {SecondsSince(start)};
+            const auto nDropped {pool.GetDroppedCount()};
+            if (nReceived + nDropped < total) {
+                std::cerr << "Timed out after " << nReceived + nDropped
+                          << " of " << total << " messages" << std::endl;
+                ok = false;
+            }
+            std::cout << std::setw(7) << nThreads
+                      << std::setw(10) << (perThread ? nThreads : 1)
+                      << std::setw(16) << static_cast<std::size_t>(
+                             nReceived / elapsed)
+                      << std::setw(12) << nReceived * messageBytes /
+                             elapsed / 1e6
+                      << std::setw(12) << nDropped
+                      << std::endl;
+        }
+    }
+
+    server.Stop();
+    serverGuard.reset();
+    serverIoc.stop();
+    for (auto& thread: serverThreads) {
+        thread.join();
+    }
+    return ok ? 0 : 1;
+}
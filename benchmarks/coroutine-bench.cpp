@@ -0,0 +1,241 @@
+#include "allocation-counter.h"
+#include "histogram.h"
+#include "loopback-server.h"
+#include "websocket-client.h"
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using NetworkMonitor::GetAllocationCount;
+using NetworkMonitor::Histogram;
+using NetworkMonitor::LoopbackServer;
+using NetworkMonitor::LoopbackServerOptions;
+using NetworkMonitor::ResetAllocationCount;
+using NetworkMonitor::ScopedAllocationCount;
+using NetworkMonitor::WebSocketClient;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::uint64_t NanosecondsSince(Clock::time_point start)
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start
+        ).count()
+    );
+}
+
+// One round trip at a time: send a message, wait for its echo. The first
+// nWarmup round trips are not measured, so that the allocator caches and
+// the socket buffers are warm.
+struct PingPong {
+    std::string payload {};
+    std::size_t nWarmup {0};
+    std::size_t nMessages {0};
+
+    Histogram roundTrips {};
+    std::size_t nReceived {0};
+    std::size_t nAllocations {0};
+    Clock::time_point start {};
+    double seconds {0};
+    bool ok {false};
+
+    void Begin(std::size_t idx)
+    {
+        if (idx == nWarmup) {
+            ResetAllocationCount();
+            start = Clock::now();
+        }
+    }
+
+    void End()
+    {
+        nAllocations = GetAllocationCount();
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        ok = nReceived == nWarmup + nMessages;
+    }
+};
+
+void RunCallbacks(
+    boost::asio::io_context& ioc,
+    const std::string& port,
+    PingPong& test
+)
+{
+    WebSocketClient client {"127.0.0.1", "/", port, ioc};
+    Clock::time_point sent {};
+    const auto sendNext = [&]() {
+        test.Begin(test.nReceived);
+        sent = Clock::now();
+        client.Send(test.payload);
+    };
+    client.Connect(
+        [&](auto ec) {
+            if (ec) {
+                std::cerr << "Could not connect: " << ec.message()
+                          << std::endl;
+                return;
+            }
+            sendNext();
+        },
+        [&](auto ec, auto&& message) {
+            if (ec || message.size() != test.payload.size()) {
+                return;
+            }
+            if (test.nReceived++ >= test.nWarmup) {
+                test.roundTrips.Record(NanosecondsSince(sent));
+            }
+            if (test.nReceived < test.nWarmup + test.nMessages) {
+                sendNext();
+                return;
+            }
+            test.End();
+            client.Close();
+        }
+    );
+    ioc.run();
+    ioc.restart();
+}
+
+// Executor is the executor the coroutine runs on. A concrete type saves the
+// allocations of wrapping the client strand in an any_io_executor.
+template <typename Executor>
+boost::asio::awaitable<void, Executor> PingPongCoroutine(
+    WebSocketClient& client,
+    PingPong& test
+)
+{
+    constexpr boost::asio::use_awaitable_t<Executor> use_awaitable {};
+    co_await client.AsyncConnect(use_awaitable);
+    for (std::size_t idx {0}; idx < test.nWarmup + test.nMessages; ++idx) {
+        test.Begin(idx);
+        const auto sent {Clock::now()};
+        co_await client.AsyncSend(test.payload, use_awaitable);
+        const auto message {co_await client.AsyncRead(use_awaitable)};
+        if (message.size() != test.payload.size()) {
+            co_return;
+        }
+        if (test.nReceived++ >= test.nWarmup) {
+            test.roundTrips.Record(NanosecondsSince(sent));
+        }
+    }
+    test.End();
+    co_await client.AsyncClose(use_awaitable);
+}
+
+// onStrand: spawn the coroutine on the client strand, or on the io_context
+// and hop to the strand for every operation.
+void RunCoroutine(
+    boost::asio::io_context& ioc,
+    const std::string& port,
+    bool onStrand,
+    PingPong& test
+)
+{
+    WebSocketClient client {"127.0.0.1", "/", port, ioc};
+    const auto onDone = [](std::exception_ptr error) {
+        try {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Coroutine failed: " << e.what() << std::endl;
+        }
+    };
+    if (onStrand) {
+        boost::asio::co_spawn(
+            client.GetExecutor(),
+            PingPongCoroutine<WebSocketClient::Strand>(client, test),
+            onDone
+        );
+    } else {
+        boost::asio::co_spawn(
+            ioc,
+            PingPongCoroutine<boost::asio::any_io_executor>(client, test),
+            onDone
+        );
+    }
+    ioc.run();
+    ioc.restart();
+}
+
+void Print(const char* name, const PingPong& test)
+{
+    const auto us = [&test](double percentile) {
+        return test.roundTrips.GetValueAtPercentile(percentile) / 1e3;
+    };
+    std::cout << name << test.nMessages / test.seconds << " round trips/s, "
+              << "p50 " << us(50) << " us, p99 " << us(99) << " us, "
+              << static_cast<double>(test.nAllocations) / test.nMessages
+              << " allocations/round trip" << std::endl;
+}
+
+} // namespace
+
+/* Ping-pongs messages with an in-process loopback echo server through the
+   callback API of WebSocketClient and through its coroutine API, and
+   reports the round-trip latency and the client-side allocations of each.
+
+   Usage: coroutine-bench [n-messages] [message-bytes] */
+int main(int argc, char* argv[])
+{
+    const std::size_t nMessages {argc > 1 ? std::stoul(argv[1]) : 50000};
+    const std::size_t messageBytes {argc > 2 ? std::stoul(argv[2]) : 256};
+
+    boost::asio::io_context serverIoc {};
+    LoopbackServer server {serverIoc, LoopbackServerOptions {}};
+    boost::system::error_code ec {};
+    server.Start(ec);
+    if (ec) {
+        std::cerr << "Could not start the server: " << ec.message()
+                  << std::endl;
+        return 1;
+    }
+    const auto port {std::to_string(server.GetPort())};
+    std::thread serverThread {[&serverIoc]() { serverIoc.run(); }};
+
+    const auto makeTest = [&]() {
+        PingPong test {};
+        test.payload = std::string(messageBytes, 'x');
+        test.nWarmup = std::min<std::size_t>(nMessages / 10 + 1, 5000);
+        test.nMessages = nMessages;
+        return test;
+    };
+
+    // The client runs on this thread. Count its allocations only: the
+    // server runs in the same process.
+    auto callbacks {makeTest()};
+    auto coroutine {makeTest()};
+    auto hopping {makeTest()};
+    {
+        const ScopedAllocationCount count {};
+        boost::asio::io_context clientIoc {1};
+        RunCallbacks(clientIoc, port, callbacks);
+        RunCoroutine(clientIoc, port, true, coroutine);
+        RunCoroutine(clientIoc, port, false, hopping);
+    }
+
+    server.Stop();
+    serverIoc.stop();
+    serverThread.join();
+
+    std::cout << nMessages << " round trips of " << messageBytes
+              << "-byte messages, one at a time" << std::endl;
+    Print("Callbacks:             ", callbacks);
+    Print("Coroutine on strand:   ", coroutine);
+    Print("Coroutine off strand:  ", hopping);
+    const bool ok {callbacks.ok && coroutine.ok && hopping.ok};
+    if (!ok) {
+        std::cerr << "Some round trips were lost" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
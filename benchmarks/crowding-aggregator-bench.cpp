@@ -0,0 +1,147 @@
+#include "crowding-aggregator.h"
+#include "network-event-parser.h"
+#include "network-layout.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NetworkMonitor::CrowdingAggregator;
+using NetworkMonitor::NetworkEvent;
+using NetworkMonitor::NetworkEventType;
+using NetworkMonitor::NetworkLayout;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Passenger-in events and single-passenger departures: every event adds
+// exactly 1 to the sum of all station and segment counts.
+std::vector<NetworkEvent> MakeEvents(
+    const NetworkLayout& layout,
+    std::size_t n,
+    std::uint32_t seed
+)
+{
+    std::mt19937 rng {seed};
+    std::uniform_int_distribution<std::uint32_t> pickEdge(
+        0, static_cast<std::uint32_t>(layout.GetEdgeCount() - 1)
+    );
+    std::vector<NetworkEvent> events(n);
+    for (std::size_t idx {0}; idx < n; ++idx) {
+        auto& event {events[idx]};
+        const auto edge {pickEdge(rng)};
+        const auto station {layout.GetEdgeSource(edge)};
+        event.stationId.Assign(layout.GetStationId(station));
+        if (idx % 2 == 0) {
+            event.type = NetworkEventType::PassengerIn;
+        } else {
+            event.type = NetworkEventType::TrainDeparture;
+            event.routeId.Assign(
+                layout.GetRouteId(layout.GetAllEdges()[edge].route)
+            );
+            event.passengers = 1;
+        }
+    }
+    return events;
+}
+
+std::int64_t Sum(const std::vector<std::int64_t>& counts)
+{
+    return std::accumulate(counts.begin(), counts.end(), std::int64_t {0});
+}
+
+} // namespace
+
+/* Reports how many events per second the crowding aggregator absorbs from
+   several writer threads while one reader keeps taking snapshots, and checks
+   that every snapshot is consistent.
+
+   Usage: crowding-aggregator-bench [layout.json] [n-events] [n-writers] */
+int main(int argc, char* argv[])
+{
+    const std::string path {argc > 1 ? argv[1] : NETWORK_LAYOUT_JSON};
+    const std::size_t nEvents {
+        argc > 2 ? std::stoul(argv[2]) : std::size_t {4000000}
+    };
+    const std::size_t nWriters {argc > 3 ? std::stoul(argv[3]) :
+        std::max(1u, std::thread::hardware_concurrency())
+    };
+
+    boost::system::error_code ec {};
+    const auto layout {NetworkLayout::FromFile(path, ec)};
+    if (ec) {
+        std::cerr << "Could not load " << path << ": " << ec.message()
+                  << std::endl;
+        return 1;
+    }
+
+    const std::size_t nPerWriter {nEvents / nWriters};
+    std::vector<std::vector<NetworkEvent>> events {};
+    for (std::size_t idx {0}; idx < nWriters; ++idx) {
+        events.push_back(MakeEvents(layout, nPerWriter,
+                                    static_cast<std::uint32_t>(idx)));
+    }
+
+    CrowdingAggregator aggregator {layout, nWriters};
+    std::atomic<std::size_t> nRunning {nWriters};
+    std::atomic<std::size_t> nRejected {0};
+    std::vector<std::thread> writers {};
+    const auto start {Clock::now()};
+    for (std::size_t idx {0}; idx < nWriters; ++idx) {
+        writers.emplace_back([&, idx]() {
+            std::size_t rejected {0};
+            for (const auto& event: events[idx]) {
+                if (!aggregator.Apply(event)) {
+                    ++rejected;
+                }
+            }
+            nRejected += rejected;
+            --nRunning;
+        });
+    }
+
+    // Snapshot continuously while the writers run.
+    CrowdingAggregator::Snapshot snapshot {};
+    std::size_t nSnapshots {0};
+    std::size_t nInconsistent {0};
+    while (nRunning > 0) {
+        aggregator.GetSnapshot(snapshot);
+        ++nSnapshots;
+        if (Sum(snapshot.stations) + Sum(snapshot.segments) !=
+            static_cast<std::int64_t>(snapshot.nEvents)) {
+            ++nInconsistent;
+        }
+    }
+    for (auto& writer: writers) {
+        writer.join();
+    }
+    const auto elapsed {SecondsSince(start)};
+
+    aggregator.GetSnapshot(snapshot);
+    const auto nApplied {nPerWriter * nWriters - nRejected};
+    const bool ok {nInconsistent == 0 && nRejected == 0 &&
+                   snapshot.nEvents == nApplied};
+
+    std::cout << "Writers: " << nWriters << ", events: "
+              << nPerWriter * nWriters << std::endl;
+    std::cout << "Updates: " << nApplied / elapsed << " events/s ("
+              << elapsed * 1e9 / nApplied << " ns/event)" << std::endl;
+    std::cout << "Snapshots: " << nSnapshots / elapsed << " snapshots/s, "
+              << nInconsistent << " inconsistent" << std::endl;
+    std::cout << "Final count: " << snapshot.nEvents << " events, "
+              << nRejected << " rejected" << std::endl;
+
+    return ok ? 0 : 1;
+}
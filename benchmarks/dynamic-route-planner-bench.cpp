@@ -0,0 +1,165 @@
+#include "dynamic-route-planner.h"
+#include "histogram.h"
+#include "network-layout.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using NetworkMonitor::DynamicRoutePlanner;
+using NetworkMonitor::Histogram;
+using NetworkMonitor::NetworkLayout;
+using NetworkMonitor::RouteQuery;
+using NetworkMonitor::StationDelayUpdate;
+using NetworkMonitor::TravelTimeUpdate;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::uint64_t NanosecondsSince(Clock::time_point start)
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start
+        ).count()
+    );
+}
+
+void Print(const char* name, const Histogram& histogram)
+{
+    std::cout << name << ": p50 " << histogram.GetValueAtPercentile(50) / 1e3
+              << " us, p99 " << histogram.GetValueAtPercentile(99) / 1e3
+              << " us, max " << histogram.GetMax() / 1e3 << " us"
+              << std::endl;
+}
+
+} // namespace
+
+/* Replays a stream of random travel time and station delay updates into a
+   DynamicRoutePlanner with watched itineraries, and reports the latency of
+   the updates and of the queries between them. Costs are checked against a
+   Dijkstra search on the current weights.
+
+   Usage: dynamic-route-planner-bench [layout.json] [n-batches] [batch-size]
+                                      [n-sources] [n-watched-per-source] */
+int main(int argc, char* argv[])
+{
+    const std::string path {argc > 1 ? argv[1] : NETWORK_LAYOUT_JSON};
+    const std::size_t nBatches {argc > 2 ? std::stoul(argv[2]) : 5000};
+    const std::size_t batchSize {argc > 3 ? std::stoul(argv[3]) : 8};
+    const std::size_t nSources {argc > 4 ? std::stoul(argv[4]) : 32};
+    const std::size_t nWatchedPerSource {argc > 5 ? std::stoul(argv[5]) : 16};
+
+    boost::system::error_code ec {};
+    const auto layout {NetworkLayout::FromFile(path, ec)};
+    if (ec) {
+        std::cerr << "Could not load " << path << ": " << ec.message()
+                  << std::endl;
+        return 1;
+    }
+    const auto nStations {static_cast<std::uint32_t>(
+        layout.GetStationCount()
+    )};
+    const auto nEdges {static_cast<std::uint32_t>(layout.GetEdgeCount())};
+    std::cout << "Layout: " << nStations << " stations, " << nEdges
+              << " edges" << std::endl;
+
+    std::mt19937 rng {42};
+    std::uniform_int_distribution<std::uint32_t> pickStation(0, nStations - 1);
+    std::uniform_int_distribution<std::uint32_t> pickEdge(0, nEdges - 1);
+    std::uniform_real_distribution<double> pickFactor(0.5, 3.0);
+    std::uniform_int_distribution<std::uint32_t> pickDelay(0, 10);
+    std::bernoulli_distribution pickDelayUpdate(0.2);
+
+    DynamicRoutePlanner planner {layout};
+    auto start {Clock::now()};
+    std::vector<RouteQuery> watched {};
+    for (std::size_t source {0}; source < nSources; ++source) {
+        const auto from {pickStation(rng)};
+        for (std::size_t idx {0}; idx < nWatchedPerSource; ++idx) {
+            const auto to {pickStation(rng)};
+            planner.Watch(from, to);
+            watched.push_back({from, to});
+        }
+    }
+    std::cout << "Watching " << watched.size() << " itineraries from "
+              << planner.GetCachedSourceCount() << " sources, set up in "
+              << NanosecondsSince(start) / 1e6 << " ms" << std::endl;
+
+    // The cost of recomputing every tree from scratch, for comparison.
+    start = Clock::now();
+    for (const auto& query: watched) {
+        planner.GetQuickestCostDijkstra(query.from, query.to);
+    }
+    const auto dijkstra {NanosecondsSince(start) / watched.size()};
+    std::cout << "One full Dijkstra: " << dijkstra / 1e3 << " us, all "
+              << planner.GetCachedSourceCount() << " trees: "
+              << dijkstra * planner.GetCachedSourceCount() / 1e3 << " us"
+              << std::endl;
+
+    Histogram updateTime {};
+    Histogram queryTime {};
+    Histogram routeTime {};
+    std::vector<TravelTimeUpdate> travelTimes {};
+    std::vector<StationDelayUpdate> delays {};
+    std::vector<RouteQuery> changed {};
+    std::size_t nChanged {0};
+    std::size_t nRepaired {0};
+    std::size_t nRebuilt {0};
+    std::size_t nMismatches {0};
+    NetworkMonitor::Itinerary itinerary {};
+    for (std::size_t batch {0}; batch < nBatches; ++batch) {
+        travelTimes.clear();
+        delays.clear();
+        for (std::size_t idx {0}; idx < batchSize; ++idx) {
+            if (pickDelayUpdate(rng)) {
+                delays.push_back({pickStation(rng), pickDelay(rng)});
+            } else {
+                const auto edge {pickEdge(rng)};
+                const auto& base {layout.GetAllEdges()[edge]};
+                travelTimes.push_back({edge, static_cast<std::uint32_t>(
+                    base.travelTime * pickFactor(rng) + 0.5
+                )});
+            }
+        }
+        start = Clock::now();
+        planner.ApplyUpdates(travelTimes, delays, changed);
+        updateTime.Record(NanosecondsSince(start));
+        nChanged += changed.size();
+        nRepaired += planner.GetLastRepairSize();
+        nRebuilt += planner.GetLastRebuildCount();
+
+        const auto& query {watched[batch % watched.size()]};
+        start = Clock::now();
+        const auto cost {planner.GetQuickestCost(query.from, query.to)};
+        queryTime.Record(NanosecondsSince(start));
+        start = Clock::now();
+        planner.GetQuickestRoute(query.from, query.to, itinerary);
+        routeTime.Record(NanosecondsSince(start));
+        if (batch % 10 == 0 &&
+            cost != planner.GetQuickestCostDijkstra(query.from, query.to)) {
+            ++nMismatches;
+        }
+    }
+
+    std::cout << nBatches << " batches of " << batchSize << " updates"
+              << std::endl;
+    Print("Update batch", updateTime);
+    Print("Cost query", queryTime);
+    Print("Route query", routeTime);
+    std::cout << "Mean labels repaired per batch: "
+              << static_cast<double>(nRepaired) / nBatches << std::endl;
+    std::cout << "Trees rebuilt instead of repaired: " << nRebuilt << " ("
+              << static_cast<double>(nRebuilt) / nBatches << " per batch)"
+              << std::endl;
+    std::cout << "Watched itineraries changed: " << nChanged << " ("
+              << static_cast<double>(nChanged) / nBatches << " per batch)"
+              << std::endl;
+    std::cout << "Validation: " << nMismatches << " mismatches in "
+              << (nBatches + 9) / 10 << " queries" << std::endl;
+    return nMismatches == 0 ? 0 : 1;
+}
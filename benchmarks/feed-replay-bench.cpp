@@ -0,0 +1,283 @@
+#include "crowding-aggregator.h"
+#include "feed-recorder.h"
+#include "histogram.h"
+#include "network-event-parser.h"
+#include "network-layout.h"
+
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NetworkMonitor::CrowdingAggregator;
+using NetworkMonitor::FeedRecorder;
+using NetworkMonitor::FeedRecorderOptions;
+using NetworkMonitor::FeedReplayer;
+using NetworkMonitor::FeedReplayerOptions;
+using NetworkMonitor::Histogram;
+using NetworkMonitor::NetworkEvent;
+using NetworkMonitor::NetworkEventParser;
+using NetworkMonitor::NetworkLayout;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// STOMP frames shaped like the live feed, on the stations and routes of the
+// layout, as WebSocketClient delivers them.
+std::vector<std::string> MakeFrames(
+    const NetworkLayout& layout,
+    std::size_t nFrames
+)
+{
+    std::mt19937 rng {42};
+    std::uniform_int_distribution<std::uint32_t> pickEdge(
+        0, static_cast<std::uint32_t>(layout.GetEdgeCount() - 1)
+    );
+    std::vector<std::string> frames {};
+    char body[256];
+    for (std::size_t idx {0}; idx < nFrames; ++idx) {
+        const auto edge {pickEdge(rng)};
+        const auto station {layout.GetStationId(layout.GetEdgeSource(edge))};
+        const auto route {layout.GetRouteId(layout.GetAllEdges()[edge].route)};
+        int size {0};
+        if (idx % 4 < 2) {
+            size = std::snprintf(body, sizeof(body),
+                "{\"datetime\":\"2026-10-17T07:%02d:%02d.000Z\","
+                "\"passenger_event\":\"%s\",\"station_id\":\"%.*s\"}",
+                static_cast<int>(idx / 60 % 60), static_cast<int>(idx % 60),
+                idx % 2 ? "in" : "out",
+                static_cast<int>(station.size()), station.data());
+        } else {
+            size = std::snprintf(body, sizeof(body),
+                "{\"datetime\":\"2026-10-17T07:%02d:%02d.000Z\","
+                "\"train_event\":\"%s\",\"route_id\":\"%.*s\","
+                "\"station_id\":\"%.*s\",\"passengers\":%d}",
+                static_cast<int>(idx / 60 % 60), static_cast<int>(idx % 60),
+                idx % 4 == 2 ? "departure" : "arrival",
+                static_cast<int>(route.size()), route.data(),
+                static_cast<int>(station.size()), station.data(),
+                static_cast<int>(idx % 300));
+        }
+        std::string frame {"MESSAGE\ndestination:/network-events\n"
+                           "content-type:application/json\n"
+                           "subscription:0\nmessage-id:"};
+        frame += std::to_string(idx);
+        frame += "\ncontent-length:";
+        frame += std::to_string(size);
+        frame += "\n\n";
+        frame.append(body, static_cast<std::size_t>(size));
+        frame += '\0';
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+std::string MakeTempPath()
+{
+    return (
+        boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path("feed-%%%%%%%%.rec")
+    ).string();
+}
+
+// Record the frames as fast as they come, timing each Record() call: that
+// is what the client strand pays. Far faster than any live feed, so the
+// writer may fall behind and the recorder drop frames.
+//
+// Returns the number of frames recorded, 0 on failure.
+std::size_t RecordFrames(
+    const std::vector<std::string>& frames,
+    const FeedRecorderOptions& options,
+    const std::string& path
+)
+{
+    FeedRecorder recorder {options};
+    boost::system::error_code ec {};
+    recorder.Open(path, ec);
+    if (ec) {
+        std::cerr << "Could not open " << path << ": " << ec.message()
+                  << std::endl;
+        return 0;
+    }
+    Histogram recordTime {};
+    const auto start {Clock::now()};
+    for (const auto& frame: frames) {
+        const auto callStart {Clock::now()};
+        recorder.Record(frame);
+        recordTime.Record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - callStart
+            ).count()
+        ));
+    }
+    const auto recordSeconds {SecondsSince(start)};
+    recorder.Close(ec);
+    const auto totalSeconds {SecondsSince(start)};
+    if (ec) {
+        std::cerr << "Recording failed: " << ec.message() << std::endl;
+        return 0;
+    }
+
+    const auto stats {recorder.GetStats()};
+    std::cout << (options.compress ? "Record, deflate: " : "Record, raw:     ")
+              << frames.size() / recordSeconds << " frames/s, Record() p50 "
+              << recordTime.GetValueAtPercentile(50) << " ns, p99 "
+              << recordTime.GetValueAtPercentile(99) << " ns, max "
+              << recordTime.GetMax() / 1e3 << " us; "
+              << stats.frameBytes / 1e6 << " MB of frames in "
+              << stats.fileBytes / 1e6 << " MB, " << stats.segments
+              << " segments, " << stats.framesDropped << " dropped, "
+              << "written in " << totalSeconds << " s" << std::endl;
+    return stats.framesRecorded;
+}
+
+bool Replay(
+    const NetworkLayout& layout,
+    const std::string& path,
+    std::size_t nExpected
+)
+{
+    FeedReplayer replayer {};
+    boost::system::error_code ec {};
+    replayer.Open(path, ec);
+    if (ec) {
+        std::cerr << "Could not open " << path << ": " << ec.message()
+                  << std::endl;
+        return false;
+    }
+
+    std::size_t nBytes {0};
+    auto start {Clock::now()};
+    auto nFrames {replayer.ReplayView([&nBytes](auto, auto frame) {
+        nBytes += frame.size();
+    }, ec)};
+    auto elapsed {SecondsSince(start)};
+    std::cout << "  Replay, no work:          " << nFrames / elapsed
+              << " frames/s, " << nBytes / elapsed / 1e6 << " MB/s"
+              << std::endl;
+    if (ec || nFrames != nExpected) {
+        std::cerr << "Replayed " << nFrames << " frames of " << nExpected
+                  << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    start = Clock::now();
+    nFrames = replayer.Replay([&nBytes](auto, auto&& frame) {
+        nBytes += frame.size();
+    }, ec);
+    elapsed = SecondsSince(start);
+    std::cout << "  Replay, std::string copy: " << nFrames / elapsed
+              << " frames/s" << std::endl;
+
+    NetworkEventParser parser {};
+    CrowdingAggregator aggregator {layout, 1};
+    std::size_t nParsed {0};
+    std::size_t nApplied {0};
+    start = Clock::now();
+    nFrames = replayer.ReplayView([&](auto, auto frame) {
+        parser.Feed(frame, [&](auto ec, const NetworkEvent& event) {
+            if (ec) {
+                return;
+            }
+            ++nParsed;
+            // Arrivals at the first stop of a route match no segment.
+            if (aggregator.Apply(event)) {
+                ++nApplied;
+            }
+        });
+    }, ec);
+    elapsed = SecondsSince(start);
+    std::cout << "  Replay, parse+aggregate:  " << nFrames / elapsed
+              << " frames/s, " << nApplied << " events applied"
+              << std::endl;
+    return !ec && nParsed == nExpected;
+}
+
+// Record a slow trickle, then check that a paced replay keeps its gaps.
+bool CheckPacing(const std::vector<std::string>& frames)
+{
+    const auto path {MakeTempPath()};
+    const std::size_t nFrames {50};
+    const std::chrono::milliseconds gap {2};
+    {
+        FeedRecorder recorder {};
+        boost::system::error_code ec {};
+        recorder.Open(path, ec);
+        for (std::size_t idx {0}; idx < nFrames && !ec; ++idx) {
+            recorder.Record(frames[idx]);
+            std::this_thread::sleep_for(gap);
+        }
+        recorder.Close(ec);
+    }
+    FeedReplayerOptions options {};
+    options.originalPacing = true;
+    FeedReplayer replayer {options};
+    boost::system::error_code ec {};
+    replayer.Open(path, ec);
+    std::vector<Clock::time_point> times {};
+    const auto start {Clock::now()};
+    replayer.ReplayView([&times](auto, auto) {
+        times.push_back(Clock::now());
+    }, ec);
+    std::remove(path.c_str());
+    if (ec || times.size() != nFrames) {
+        std::cerr << "Paced replay failed: " << ec.message() << std::endl;
+        return false;
+    }
+    const auto span {std::chrono::duration<double, std::milli>(
+        times.back() - times.front()
+    ).count()};
+    std::cout << "Paced replay: " << nFrames << " frames recorded "
+              << gap.count() << " ms apart, replayed over " << span
+              << " ms (" << SecondsSince(start) * 1e3 << " ms in total)"
+              << std::endl;
+    return span >= (nFrames - 1) * gap.count();
+}
+
+} // namespace
+
+/* Records synthetic feed frames with FeedRecorder, raw and deflated, then
+   replays them as fast as possible: on their own, and through the event
+   parser and the crowding aggregator. Also checks that a paced replay keeps
+   the recorded gaps.
+
+   Usage: feed-replay-bench [layout.json] [n-frames] */
+int main(int argc, char* argv[])
+{
+    const std::string layoutPath {argc > 1 ? argv[1] : NETWORK_LAYOUT_JSON};
+    const std::size_t nFrames {
+        argc > 2 ? std::stoul(argv[2]) : std::size_t {500000}
+    };
+
+    boost::system::error_code ec {};
+    const auto layout {NetworkLayout::FromFile(layoutPath, ec)};
+    if (ec) {
+        std::cerr << "Could not load " << layoutPath << ": " << ec.message()
+                  << std::endl;
+        return 1;
+    }
+    const auto frames {MakeFrames(layout, nFrames)};
+
+    bool ok {true};
+    for (const auto compress: {false, true}) {
+        FeedRecorderOptions options {};
+        options.compress = compress;
+        const auto path {MakeTempPath()};
+        const auto nRecorded {RecordFrames(frames, options, path)};
+        ok = ok && nRecorded > 0 && Replay(layout, path, nRecorded);
+        std::remove(path.c_str());
+    }
+    ok = ok && CheckPacing(frames);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+#include "histogram.h"
+#include "loopback-server.h"
+#include "metrics-exporter.h"
+#include "websocket-client.h"
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NetworkMonitor::AtomicHistogram;
+using NetworkMonitor::Histogram;
+using NetworkMonitor::LoopbackMode;
+using NetworkMonitor::LoopbackServer;
+using NetworkMonitor::LoopbackServerOptions;
+using NetworkMonitor::MetricsRegistry;
+using NetworkMonitor::MetricsServer;
+using NetworkMonitor::WebSocketClient;
+using NetworkMonitor::WebSocketClientOptions;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Nanoseconds per call of f, over n calls.
+double PerCall(std::size_t n, const std::function<void (std::size_t)>& f)
+{
+    const auto start {Clock::now()};
+    for (std::size_t idx {0}; idx < n; ++idx) {
+        f(idx);
+    }
+    return std::chrono::duration<double, std::nano>(
+        Clock::now() - start
+    ).count() / n;
+}
+
+// The values a callback histogram sees: mostly 1-10 us.
+std::uint64_t MakeValue(std::size_t idx)
+{
+    return 1000 + (idx * 2654435761u) % 9000;
+}
+
+// Connections echo nMessages each through an in-process server, with up to
+// `window` messages in flight. Returns messages per second, or 0 on failure.
+double Echo(
+    bool callbackMetrics,
+    std::size_t nConnections,
+    std::size_t nMessages,
+    std::size_t window,
+    MetricsRegistry& registry,
+    double& scrapeMicroseconds,
+    std::size_t& scrapeBytes
+)
+{
+    boost::asio::io_context serverIoc {};
+    LoopbackServerOptions serverOptions {};
+    serverOptions.mode = LoopbackMode::Echo;
+    LoopbackServer server {serverIoc, serverOptions};
+    MetricsServer metricsServer {serverIoc, registry};
+    boost::system::error_code ec {};
+    server.Start(ec);
+    if (!ec) {
+        metricsServer.Start(ec);
+    }
+    if (ec) {
+        std::cerr << "Could not start the servers: " << ec.message()
+                  << std::endl;
+        return 0;
+    }
+    std::thread serverThread {[&serverIoc]() { serverIoc.run(); }};
+
+    boost::asio::io_context clientIoc {1};
+    auto clientGuard {boost::asio::make_work_guard(clientIoc)};
+    std::thread clientThread {[&clientIoc]() { clientIoc.run(); }};
+
+    WebSocketClientOptions options {};
+    options.callbackMetrics = callbackMetrics;
+    const std::string message(64, 'x');
+    std::atomic<std::size_t> nConnected {0};
+    std::atomic<std::size_t> nDone {0};
+    std::vector<std::unique_ptr<WebSocketClient>> clients {};
+    std::vector<std::size_t> nSent(nConnections, 0);
+    std::vector<std::size_t> nReceived(nConnections, 0);
+    for (std::size_t idx {0}; idx < nConnections; ++idx) {
+        clients.push_back(std::make_unique<WebSocketClient>(
+            "127.0.0.1", "/", std::to_string(server.GetPort()), clientIoc,
+            options
+        ));
+        auto& client {*clients.back()};
+        registry.Add("conn-" + std::to_string(idx), client);
+        auto& sent {nSent[idx]};
+        auto& received {nReceived[idx]};
+        client.ConnectView(
+            [&nConnected](auto ec) {
+                if (!ec) {
+                    ++nConnected;
+                }
+            },
+            [&, nMessages](auto /*ec*/, auto) {
+                if (++received == nMessages) {
+                    ++nDone;
+                }
+                if (sent < nMessages) {
+                    ++sent;
+                    client.Send(message);
+                }
+            }
+        );
+    }
+
+    const auto wait = [](auto&& done) {
+        const auto deadline {Clock::now() + std::chrono::seconds {60}};
+        while (!done() && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds {1});
+        }
+        return done();
+    };
+    bool ok {wait([&]() { return nConnected == nConnections; })};
+
+    const auto start {Clock::now()};
+    if (ok) {
+        for (std::size_t idx {0}; idx < nConnections; ++idx) {
+            boost::asio::post(clientIoc, [&, idx]() {
+                for (; nSent[idx] < window && nSent[idx] < nMessages;
+                     ++nSent[idx]) {
+                    clients[idx]->Send(message);
+                }
+            });
+        }
+        ok = wait([&]() { return nDone == nConnections; });
+    }
+    const auto seconds {std::chrono::duration<double>(
+        Clock::now() - start
+    ).count()};
+
+    // One scrape over HTTP, as Prometheus would do it.
+    if (ok) {
+        namespace http = boost::beast::http;
+        boost::asio::io_context scrapeIoc {};
+        boost::beast::tcp_stream stream {scrapeIoc};
+        const auto scrapeStart {Clock::now()};
+        stream.connect({boost::asio::ip::make_address("127.0.0.1"),
+                        metricsServer.GetPort()}, ec);
+        http::request<http::empty_body> request {http::verb::get,
+                                                 "/metrics", 11};
+        request.set(http::field::host, "127.0.0.1");
+        http::response<http::string_body> response {};
+        boost::beast::flat_buffer buffer {};
+        if (!ec) {
+            http::write(stream, request, ec);
+        }
+        if (!ec) {
+            http::read(stream, buffer, response, ec);
+        }
+        scrapeMicroseconds = std::chrono::duration<double, std::micro>(
+            Clock::now() - scrapeStart
+        ).count();
+        scrapeBytes = response.body().size();
+        ok = !ec && response.result() == http::status::ok;
+        if (!ok) {
+            std::cerr << "Scrape failed: " << ec.message() << std::endl;
+        }
+    }
+
+    for (std::size_t idx {0}; idx < nConnections; ++idx) {
+        registry.Remove("conn-" + std::to_string(idx));
+        clients[idx]->Close();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds {100});
+    metricsServer.Stop();
+    server.Stop();
+    clientGuard.reset();
+    clientIoc.stop();
+    clientThread.join();
+    serverIoc.stop();
+    serverThread.join();
+    return ok ? nConnections * nMessages / seconds : 0;
+}
+
+} // namespace
+
+/* Measures what the client metrics cost: the primitives they are built
+   from, the echo throughput with callback timing off and on, and the time
+   to format and scrape them.
+
+   Usage: metrics-bench [n-connections] [n-messages] [window] */
+int main(int argc, char* argv[])
+{
+    const std::size_t nConnections {argc > 1 ? std::stoul(argv[1]) : 4};
+    const std::size_t nMessages {argc > 2 ? std::stoul(argv[2]) : 50000};
+    const std::size_t window {argc > 3 ? std::stoul(argv[3]) : 16};
+
+    constexpr std::size_t nCalls {20000000};
+    Histogram histogram {AtomicHistogram::kDefaultSubBucketBits};
+    AtomicHistogram atomicHistogram {};
+    std::atomic<std::uint64_t> counter {0};
+    std::uint64_t sink {0};
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Histogram::Record        "
+              << PerCall(nCalls, [&](auto idx) {
+                     histogram.Record(MakeValue(idx));
+                 }) << " ns" << std::endl;
+    std::cout << "AtomicHistogram::Record  "
+              << PerCall(nCalls, [&](auto idx) {
+                     atomicHistogram.Record(MakeValue(idx));
+                 }) << " ns" << std::endl;
+    std::cout << "Counter increment        "
+              << PerCall(nCalls, [&](auto) {
+                     counter.store(counter.load(std::memory_order_relaxed) + 1,
+                                   std::memory_order_relaxed);
+                 }) << " ns" << std::endl;
+    std::cout << "Two steady_clock reads   "
+              << PerCall(nCalls / 4, [&](auto) {
+                     const auto start {Clock::now()};
+                     sink += (Clock::now() - start).count();
+                 }) << " ns" << std::endl;
+    std::cout << "AtomicHistogram snapshot "
+              << PerCall(10000, [&](auto) {
+                     sink += atomicHistogram.Snapshot().GetCount();
+                 }) << " ns" << std::endl;
+    if (sink == 42) {
+        std::cout << std::endl;
+    }
+
+    std::cout << std::endl << nConnections << " connections, " << nMessages
+              << " echoes each, window " << window << std::endl;
+    MetricsRegistry registry {};
+    for (const auto callbackMetrics: {false, true, false, true}) {
+        double scrapeMicroseconds {0};
+        std::size_t scrapeBytes {0};
+        const auto rate {Echo(callbackMetrics, nConnections, nMessages,
+                              window, registry, scrapeMicroseconds,
+                              scrapeBytes)};
+        if (rate == 0) {
+            std::cerr << "The run did not complete" << std::endl;
+            return 1;
+        }
+        std::cout << "callback timing " << (callbackMetrics ? "on:  " : "off: ")
+                  << std::setprecision(0) << rate << " msg/s, scrape "
+                  << scrapeBytes << " B in " << scrapeMicroseconds << " us"
+                  << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+#include "allocation-counter.h"
+#include "network-event-parser.h"
+
+#include <boost/json.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using NetworkMonitor::GetAllocationCount;
+using NetworkMonitor::NetworkEvent;
+using NetworkMonitor::NetworkEventParser;
+using NetworkMonitor::ScopedAllocationCount;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Frames shaped like the live feed, for when no recording is given.
+std::string MakeFrames(std::size_t nFrames)
+{
+    std::mt19937 rng {42};
+    std::uniform_int_distribution<int> station(0, 425);
+    std::uniform_int_distribution<int> route(0, 95);
+    std::uniform_int_distribution<int> kind(0, 3);
+    std::string frames {};
+    char body[256];
+    for (std::size_t idx {0}; idx < nFrames; ++idx) {
+        int size {0};
+        switch (kind(rng)) {
+        case 0:
+        case 1:
+            size = std::snprintf(body, sizeof(body),
+                "{\"datetime\":\"2026-10-17T07:%02d:%02d.000Z\","
+                "\"passenger_event\":\"%s\",\"station_id\":\"station_%03d\"}",
+                static_cast<int>(idx / 60 % 60), static_cast<int>(idx % 60),
+                idx % 2 ? "in" : "out", station(rng));
+            break;
+        default:
+            size = std::snprintf(body, sizeof(body),
+                "{\"datetime\":\"2026-10-17T07:%02d:%02d.000Z\","
+                "\"train_event\":\"departure\",\"route_id\":\"route_%03d\","
+                "\"station_id\":\"station_%03d\",\"passengers\":%d}",
+                static_cast<int>(idx / 60 % 60), static_cast<int>(idx % 60),
+                route(rng), station(rng), static_cast<int>(idx % 300));
+            break;
+        }
+        frames += "MESSAGE\ndestination:/network-events\n"
+                  "content-type:application/json\n"
+                  "subscription:0\nmessage-id:";
+        frames += std::to_string(idx);
+        frames += "\ncontent-length:";
+        frames += std::to_string(size);
+        frames += "\n\n";
+        frames.append(body, static_cast<std::size_t>(size));
+        frames += '\0';
+        frames += '\n';
+    }
+    return frames;
+}
+
+// The DOM way: parse the body with Boost.JSON and copy out the fields.
+struct DomEvent {
+    std::string type;
+    std::string datetime;
+    std::string stationId;
+    std::string routeId;
+    std::int64_t passengers {0};
+};
+
+std::size_t ParseWithDom(const std::string& frames, std::uint64_t& checksum)
+{
+    std::size_t nFrames {0};
+    std::size_t pos {0};
+    while (true) {
+        const auto nul {frames.find('\0', pos)};
+        if (nul == std::string::npos) {
+            break;
+        }
+        const auto bodyStart {frames.find("\n\n", pos)};
+        if (bodyStart == std::string::npos || bodyStart > nul) {
+            break;
+        }
+        const boost::json::string_view body {
+            frames.data() + bodyStart + 2, nul - bodyStart - 2
+        };
+        boost::system::error_code ec {};
+        const auto value {boost::json::parse(body, ec)};
+        pos = nul + 1;
+        if (ec || !value.is_object()) {
+            continue;
+        }
+        const auto& obj {value.as_object()};
+        DomEvent event {};
+        const auto get = [&obj](const char* key, std::string& out) {
+            if (const auto field {obj.if_contains(key)}) {
+                if (field->is_string()) {
+                    out = std::string(field->as_string().c_str());
+                }
+            }
+        };
+        get("passenger_event", event.type);
+        get("train_event", event.type);
+        get("datetime", event.datetime);
+        get("station_id", event.stationId);
+        get("route_id", event.routeId);
+        if (const auto field {obj.if_contains("passengers")}) {
+            event.passengers = field->as_int64();
+        }
+        checksum += event.stationId.size() + event.passengers;
+        ++nFrames;
+    }
+    return nFrames;
+}
+
+} // namespace
+
+/* Compares the streaming event parser with Boost.JSON DOM parsing.
+
+   Usage: network-event-parser-bench [recording] [n-frames]
+
+   The recording is a file of raw STOMP frames, as received from the feed.
+   Without one, the benchmark generates n-frames synthetic frames. */
+int main(int argc, char* argv[])
+{
+    std::string frames {};
+    if (argc > 1 && argv[1][0] != '\0') {
+        std::ifstream file {argv[1], std::ios::binary};
+        std::stringstream contents {};
+        contents << file.rdbuf();
+        frames = contents.str();
+    } else {
+        frames = MakeFrames(argc > 2 ? std::stoul(argv[2]) : 200000);
+    }
+    const double megabytes {frames.size() / 1e6};
+
+    // Feed the streaming parser in uneven chunks, as a socket would.
+    NetworkEventParser parser {};
+    std::vector<std::size_t> chunks {};
+    std::mt19937 rng {7};
+    std::uniform_int_distribution<std::size_t> chunkSize(1, 16384);
+    for (std::size_t pos {0}; pos < frames.size(); ) {
+        chunks.push_back(std::min(chunkSize(rng), frames.size() - pos));
+        pos += chunks.back();
+    }
+
+    std::uint64_t checksum {0};
+    std::size_t nFrames {0};
+    std::size_t nErrors {0};
+    // Count heap allocations, to show which parser allocates per message.
+    const ScopedAllocationCount count {};
+    auto allocations {GetAllocationCount()};
+    auto start {Clock::now()};
+    std::size_t pos {0};
+    for (const auto size: chunks) {
+        nFrames += parser.Feed({frames.data() + pos, size},
+            [&checksum, &nErrors](auto ec, const NetworkEvent& event) {
+                if (ec) {
+                    ++nErrors;
+                }
+                checksum += event.stationId.View().size() + event.passengers;
+            }
+        );
+        pos += size;
+    }
+    auto elapsed {SecondsSince(start)};
+    auto nAllocations {GetAllocationCount() - allocations};
+    std::cout << "Streaming parser: " << nFrames << " frames, " << nErrors
+              << " errors, " << nFrames / elapsed << " frames/s, "
+              << megabytes / elapsed << " MB/s, "
+              << static_cast<double>(nAllocations) / nFrames
+              << " allocations/frame (checksum " << checksum << ")"
+              << std::endl;
+
+    checksum = 0;
+    allocations = GetAllocationCount();
+    start = Clock::now();
+    nFrames = ParseWithDom(frames, checksum);
+    elapsed = SecondsSince(start);
+    nAllocations = GetAllocationCount() - allocations;
+    std::cout << "Boost.JSON DOM:   " << nFrames << " frames, "
+              << nFrames / elapsed << " frames/s, "
+              << megabytes / elapsed << " MB/s, "
+              << static_cast<double>(nAllocations) / nFrames
+              << " allocations/frame (checksum " << checksum << ")"
+              << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "network-layout.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using NetworkMonitor::NetworkLayout;
+using NetworkMonitor::RouteIndex;
+using NetworkMonitor::StationIndex;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Median of n runs, in milliseconds.
+double Time(std::size_t n, const std::function<void ()>& load)
+{
+    std::vector<double> times {};
+    for (std::size_t idx {0}; idx < n; ++idx) {
+        const auto start {Clock::now()};
+        load();
+        times.push_back(std::chrono::duration<double, std::milli>(
+            Clock::now() - start
+        ).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+bool SameLayout(const NetworkLayout& a, const NetworkLayout& b)
+{
+    if (a.GetStationCount() != b.GetStationCount() ||
+        a.GetLineCount() != b.GetLineCount() ||
+        a.GetRouteCount() != b.GetRouteCount() ||
+        a.GetEdgeCount() != b.GetEdgeCount()) {
+        return false;
+    }
+    for (StationIndex station {0}; station < a.GetStationCount(); ++station) {
+        const auto edgesA {a.GetEdges(station)};
+        const auto edgesB {b.GetEdges(station)};
+        if (a.GetStationId(station) != b.GetStationId(station) ||
+            a.GetStationName(station) != b.GetStationName(station) ||
+            b.FindStation(a.GetStationId(station)) != station ||
+            edgesA.size() != edgesB.size() ||
+            a.GetStationRoutes(station).size() !=
+                b.GetStationRoutes(station).size()) {
+            return false;
+        }
+        for (std::size_t idx {0}; idx < edgesA.size(); ++idx) {
+            if (edgesA[idx].to != edgesB[idx].to ||
+                edgesA[idx].route != edgesB[idx].route ||
+                edgesA[idx].travelTime != edgesB[idx].travelTime) {
+                return false;
+            }
+        }
+    }
+    for (RouteIndex route {0}; route < a.GetRouteCount(); ++route) {
+        const auto stopsA {a.GetRouteStops(route)};
+        const auto stopsB {b.GetRouteStops(route)};
+        if (a.GetRouteId(route) != b.GetRouteId(route) ||
+            a.GetRouteDirection(route) != b.GetRouteDirection(route) ||
+            !std::equal(stopsA.begin(), stopsA.end(),
+                        stopsB.begin(), stopsB.end())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+/* Compares the startup cost of parsing the layout JSON against mapping a
+   binary snapshot of it, with and without checking the snapshot checksum.
+   The files are in the page cache after the first run, so this is the cost
+   of a warm restart.
+
+   Usage: network-layout-bench [layout.json] [n-runs] */
+int main(int argc, char* argv[])
+{
+    const std::string path {argc > 1 ? argv[1] : NETWORK_LAYOUT_JSON};
+    const std::size_t nRuns {argc > 2 ? std::stoul(argv[2]) : 20};
+    const auto snapshot {(
+        boost::filesystem::temp_directory_path() /
+        boost::filesystem::unique_path("network-layout-%%%%%%%%.snapshot")
+    ).string()};
+
+    boost::system::error_code ec {};
+    const auto layout {NetworkLayout::FromFile(path, ec)};
+    if (!ec) {
+        layout.WriteSnapshot(snapshot, ec);
+    }
+    if (ec) {
+        std::cerr << "Could not compile " << path << ": " << ec.message()
+                  << std::endl;
+        return 1;
+    }
+    const auto mapped {NetworkLayout::FromSnapshot(snapshot, ec)};
+    if (ec || !SameLayout(layout, mapped)) {
+        std::cerr << "The snapshot does not match the JSON layout"
+                  << std::endl;
+        std::remove(snapshot.c_str());
+        return 1;
+    }
+
+    const auto json {Time(nRuns, [&path]() {
+        boost::system::error_code ec {};
+        NetworkLayout::FromFile(path, ec);
+    })};
+    const auto verified {Time(nRuns, [&snapshot]() {
+        boost::system::error_code ec {};
+        NetworkLayout::FromSnapshot(snapshot, ec);
+    })};
+    const auto unverified {Time(nRuns, [&snapshot]() {
+        boost::system::error_code ec {};
+        NetworkLayout::FromSnapshot(snapshot, ec, false);
+    })};
+    std::remove(snapshot.c_str());
+
+    std::cout << "Layout: " << layout.GetStationCount() << " stations, "
+              << layout.GetRouteCount() << " routes, "
+              << layout.GetEdgeCount() << " edges" << std::endl;
+    std::cout << "Parse JSON:               " << json << " ms" << std::endl;
+    std::cout << "Map snapshot, checksum:   " << verified << " ms ("
+              << json / verified << "x)" << std::endl;
+    std::cout << "Map snapshot, no check:   " << unverified << " ms ("
+              << json / unverified << "x)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include "loopback-server.h"
+#include "websocket-client.h"
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NetworkMonitor::LoopbackServer;
+using NetworkMonitor::WebSocketClient;
+using NetworkMonitor::WebSocketClientOptions;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisecondsBetween(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename Predicate>
+bool WaitFor(Predicate&& predicate, std::chrono::milliseconds timeout)
+{
+    const auto deadline {Clock::now() + timeout};
+    while (!predicate()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds {100});
+    }
+    return true;
+}
+
+double Percentile(std::vector<double> values, double percentile)
+{
+    std::sort(values.begin(), values.end());
+    const auto idx {static_cast<std::size_t>(
+        percentile * static_cast<double>(values.size() - 1)
+    )};
+    return values[idx];
+}
+
+} // namespace
+
+/* Kills and restarts an in-process WebSocket server over and over, and
+   reports how long the client takes to notice the drop and to be connected
+   again once the server is back.
+
+   Usage: reconnect-bench [n-rounds] [downtime-ms] [max-backoff-ms] */
+int main(int argc, char* argv[])
+{
+    const std::size_t nRounds {
+        argc > 1 ? std::stoul(argv[1]) : std::size_t {20}
+    };
+    const std::chrono::milliseconds downtime {
+        argc > 2 ? std::stol(argv[2]) : 200
+    };
+    const std::chrono::milliseconds maxBackoff {
+        argc > 3 ? std::stol(argv[3]) : 50
+    };
+
+    boost::asio::io_context serverIoc {};
+    auto serverGuard {boost::asio::make_work_guard(serverIoc)};
+    std::thread serverThread {[&serverIoc]() { serverIoc.run(); }};
+    // Stop() drops every connection without a close handshake, like a
+    // crashing server would. Start() comes back on the same port.
+    LoopbackServer server {serverIoc};
+    boost::system::error_code ec {};
+    server.Start(ec);
+    if (ec) {
+        std::cerr << "Could not start the server: " << ec.message()
+                  << std::endl;
+        return 1;
+    }
+
+    WebSocketClientOptions options {};
+    options.reconnect.enabled = true;
+    options.reconnect.maxDelay = maxBackoff;
+
+    boost::asio::io_context clientIoc {};
+    auto clientGuard {boost::asio::make_work_guard(clientIoc)};
+    std::thread clientThread {[&clientIoc]() { clientIoc.run(); }};
+
+    // "localhost" goes through the resolver, so the DNS cache is exercised.
+    WebSocketClient client {"localhost", "/", std::to_string(server.GetPort()),
+                            clientIoc, options};
+    std::atomic<std::size_t> nConnects {0};
+    std::atomic<std::size_t> nDisconnects {0};
+    std::atomic<Clock::rep> connectTime {0};
+    std::atomic<Clock::rep> disconnectTime {0};
+    client.Connect(
+        [&](auto ec) {
+            if (!ec) {
+                connectTime = Clock::now().time_since_epoch().count();
+                ++nConnects;
+            }
+        },
+        nullptr,
+        [&](auto /*ec*/) {
+            disconnectTime = Clock::now().time_since_epoch().count();
+            ++nDisconnects;
+        }
+    );
+
+    const auto timeout {std::chrono::seconds {10}};
+    if (!WaitFor([&]() { return nConnects == 1; }, timeout)) {
+        std::cerr << "Could not connect" << std::endl;
+        return 1;
+    }
+
+    std::vector<double> detectMs {};
+    std::vector<double> recoveryMs {};
+    for (std::size_t round {0}; round < nRounds; ++round) {
+        const auto killed {Clock::now()};
+        server.Stop();
+        if (!WaitFor([&]() { return nDisconnects == round + 1; }, timeout)) {
+            std::cerr << "Drop not detected in round " << round << std::endl;
+            return 1;
+        }
+        detectMs.push_back(MillisecondsBetween(killed, Clock::time_point {
+            Clock::duration {disconnectTime.load()}
+        }));
+
+        std::this_thread::sleep_for(downtime);
+        const auto restarted {Clock::now()};
+        server.Start(ec);
+        const auto back = [&]() { return nConnects == round + 2; };
+        if (ec || !WaitFor(back, timeout)) {
+            std::cerr << "No reconnection in round " << round << std::endl;
+            return 1;
+        }
+        recoveryMs.push_back(MillisecondsBetween(restarted, Clock::time_point {
+            Clock::duration {connectTime.load()}
+        }));
+    }
+
+    std::cout << nRounds << " restarts, " << downtime.count()
+              << " ms downtime, backoff capped at " << maxBackoff.count()
+              << " ms" << std::endl;
+    std::cout << "Drop detected after: median "
+              << Percentile(detectMs, 0.5) << " ms, max "
+              << Percentile(detectMs, 1.0) << " ms" << std::endl;
+    std::cout << "Reconnected after restart: median "
+              << Percentile(recoveryMs, 0.5) << " ms, max "
+              << Percentile(recoveryMs, 1.0) << " ms" << std::endl;
+    std::cout << "Reconnections: " << client.GetReconnectCount() << std::endl;
+
+    client.Close();
+    server.Stop();
+    clientGuard.reset();
+    serverGuard.reset();
+    clientIoc.stop();
+    serverIoc.stop();
+    clientThread.join();
+    serverThread.join();
+    return client.GetReconnectCount() == nRounds ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#include "network-layout.h"
+#include "route-planner.h"
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NetworkMonitor::NetworkLayout;
+using NetworkMonitor::RoutePlanner;
+using NetworkMonitor::RouteQuery;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<RouteQuery> MakeQueries(std::size_t nStations, std::size_t n)
+{
+    std::mt19937 rng {42};
+    std::uniform_int_distribution<std::uint32_t> pick(
+        0, static_cast<std::uint32_t>(nStations - 1)
+    );
+    std::vector<RouteQuery> queries(n);
+    for (auto& query: queries) {
+        query = {pick(rng), pick(rng)};
+    }
+    return queries;
+}
+
+} // namespace
+
+/* Reports how fast the route planner answers quickest-path queries on a
+   network layout.
+
+   Usage: route-planner-bench [layout.json] [n-queries] [n-threads] */
+int main(int argc, char* argv[])
+{
+    const std::string path {argc > 1 ? argv[1] : NETWORK_LAYOUT_JSON};
+    const std::size_t nQueries {
+        argc > 2 ? std::stoul(argv[2]) : std::size_t {1000000}
+    };
+    const std::size_t nThreads {argc > 3 ? std::stoul(argv[3]) :
+        std::max(1u, std::thread::hardware_concurrency())
+    };
+
+    boost::system::error_code ec {};
+    auto start {Clock::now()};
+    const auto layout {NetworkLayout::FromFile(path, ec)};
+    if (ec) {
+        std::cerr << "Could not load " << path << ": " << ec.message()
+                  << std::endl;
+        return 1;
+    }
+    std::cout << "Layout: " << layout.GetStationCount() << " stations, "
+              << layout.GetRouteCount() << " routes, "
+              << layout.GetEdgeCount() << " edges, loaded in "
+              << SecondsSince(start) * 1e3 << " ms" << std::endl;
+
+    start = Clock::now();
+    const RoutePlanner planner {layout};
+    std::cout << "Preprocessing: " << SecondsSince(start) * 1e3 << " ms, "
+              << planner.GetLabelCount() << " label entries" << std::endl;
+
+    const auto queries {MakeQueries(layout.GetStationCount(), nQueries)};
+
+    // Check the labels against Dijkstra, and time Dijkstra while at it.
+    const std::size_t nChecks {std::min<std::size_t>(nQueries, 5000)};
+    std::size_t mismatches {0};
+    start = Clock::now();
+    for (std::size_t idx {0}; idx < nChecks; ++idx) {
+        const auto& query {queries[idx]};
+        if (planner.GetQuickestCostDijkstra(query.from, query.to) !=
+            planner.GetQuickestCost(query.from, query.to)) {
+            ++mismatches;
+        }
+    }
+    const auto dijkstraQps {nChecks / SecondsSince(start)};
+    std::cout << "Validation: " << mismatches << " mismatches in " << nChecks
+              << " queries" << std::endl;
+    std::cout << "Dijkstra: " << dijkstraQps << " queries/s" << std::endl;
+
+    // Not every pair of stations is connected in the shipped layout.
+    std::size_t nReachable {0};
+    start = Clock::now();
+    for (const auto& query: queries) {
+        if (planner.GetQuickestCost(query.from, query.to) !=
+            NetworkMonitor::kUnreachable) {
+            ++nReachable;
+        }
+    }
+    auto elapsed {SecondsSince(start)};
+    std::cout << "Hub labels, 1 thread: " << nQueries / elapsed
+              << " queries/s (" << elapsed * 1e9 / nQueries << " ns/query, "
+              << nReachable << " reachable pairs)" << std::endl;
+
+    NetworkMonitor::Itinerary itinerary {};
+    const std::size_t nRoutes {std::min<std::size_t>(nQueries, 100000)};
+    start = Clock::now();
+    for (std::size_t idx {0}; idx < nRoutes; ++idx) {
+        planner.GetQuickestRoute(queries[idx].from, queries[idx].to,
+                                 itinerary);
+    }
+    elapsed = SecondsSince(start);
+    std::cout << "Full itineraries, 1 thread: " << nRoutes / elapsed
+              << " queries/s" << std::endl;
+
+    boost::asio::thread_pool pool {nThreads};
+    std::vector<std::uint32_t> costs {};
+    start = Clock::now();
+    planner.GetQuickestCosts(queries, costs, pool);
+    elapsed = SecondsSince(start);
+    std::cout << "Hub labels, batch on " << nThreads << " threads: "
+              << nQueries / elapsed << " queries/s" << std::endl;
+    pool.join();
+
+    return mismatches == 0 ? 0 : 1;
+}
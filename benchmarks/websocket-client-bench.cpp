@@ -0,0 +1,221 @@
+#include "histogram.h"
+#include "loopback-server.h"
+#include "websocket-client.h"
+
+#include <boost/asio.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NetworkMonitor::Histogram;
+using NetworkMonitor::LoopbackMode;
+using NetworkMonitor::LoopbackServer;
+using NetworkMonitor::LoopbackServerOptions;
+using NetworkMonitor::WebSocketClient;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Echo messages carry their send time, as 16 hex digits, so that the round
+// trip can be measured on the way back. Hex keeps the text frames valid UTF-8.
+constexpr std::size_t kStampBytes {16};
+
+std::uint64_t Now()
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()
+        ).count()
+    );
+}
+
+std::string MakeMessage(std::size_t messageBytes)
+{
+    static const char* digits {"0123456789abcdef"};
+    std::string message(std::max(messageBytes, kStampBytes), 'x');
+    auto stamp {Now()};
+    for (std::size_t idx {kStampBytes}; idx > 0; --idx) {
+        message[idx - 1] = digits[stamp & 0xF];
+        stamp >>= 4;
+    }
+    return message;
+}
+
+std::uint64_t ReadStamp(boost::beast::string_view message)
+{
+    std::uint64_t stamp {0};
+    for (std::size_t idx {0}; idx < kStampBytes && idx < message.size();
+         ++idx) {
+        const auto c {message[idx]};
+        stamp = (stamp << 4) |
+                static_cast<std::uint64_t>(c <= '9' ? c - '0' : c - 'a' + 10);
+    }
+    return stamp;
+}
+
+// Only touched on the connection's strand until the io_context is stopped.
+struct Connection {
+    std::unique_ptr<WebSocketClient> client {};
+    Histogram roundTrips {};
+    std::size_t nReceived {0};
+    std::size_t nBytes {0};
+};
+
+} // namespace
+
+/* Drives WebSocketClient against a loopback server and reports messages/s,
+   bytes/s and, in echo mode, round-trip latency percentiles.
+
+   By default the server runs in-process. Give a host and port to use an
+   external `loopback-server` started in the same mode instead.
+
+   Usage: websocket-client-bench [echo|flood] [n-connections] [message-bytes]
+                                 [seconds] [window] [n-client-threads]
+                                 [host] [port] */
+int main(int argc, char* argv[])
+{
+    const std::string mode {argc > 1 ? argv[1] : "echo"};
+    const bool echo {mode == "echo"};
+    const std::size_t nConnections {argc > 2 ? std::stoul(argv[2]) : 8};
+    const std::size_t messageBytes {argc > 3 ? std::stoul(argv[3]) : 256};
+    const std::chrono::duration<double> duration {
+        argc > 4 ? std::stod(argv[4]) : 5.0
+    };
+    const std::size_t window {argc > 5 ? std::stoul(argv[5]) : 16};
+    const std::size_t nClientThreads {argc > 6 ? std::stoul(argv[6]) : 1};
+    std::string host {argc > 7 ? argv[7] : "127.0.0.1"};
+    std::string port {argc > 8 ? argv[8] : ""};
+
+    boost::asio::io_context serverIoc {};
+    LoopbackServerOptions serverOptions {};
+    serverOptions.mode = echo ? LoopbackMode::Echo : LoopbackMode::Flood;
+    serverOptions.messageBytes = messageBytes;
+    LoopbackServer server {serverIoc, serverOptions};
+    std::thread serverThread {};
+    if (port.empty()) {
+        boost::system::error_code ec {};
+        server.Start(ec);
+        if (ec) {
+            std::cerr << "Could not start the server: " << ec.message()
+                      << std::endl;
+            return 1;
+        }
+        port = std::to_string(server.GetPort());
+        serverThread = std::thread {[&serverIoc]() { serverIoc.run(); }};
+    }
+
+    boost::asio::io_context clientIoc {static_cast<int>(nClientThreads)};
+    auto clientGuard {boost::asio::make_work_guard(clientIoc)};
+    std::vector<std::thread> clientThreads {};
+    for (std::size_t idx {0}; idx < nClientThreads; ++idx) {
+        clientThreads.emplace_back([&clientIoc]() { clientIoc.run(); });
+    }
+
+    std::atomic<bool> measuring {false};
+    std::atomic<std::size_t> nConnected {0};
+    std::vector<Connection> connections(nConnections);
+    for (auto& connection: connections) {
+        connection.client = std::make_unique<WebSocketClient>(
+            host, "/", port, clientIoc
+        );
+        auto& client {*connection.client};
+        client.ConnectView(
+            [&nConnected](auto ec) {
+                if (ec) {
+                    std::cerr << "Could not connect: " << ec.message()
+                              << std::endl;
+                    return;
+                }
+                ++nConnected;
+            },
+            [&, echo, messageBytes](auto /*ec*/, auto message) {
+                if (!measuring) {
+                    return;
+                }
+                ++connection.nReceived;
+                connection.nBytes += message.size();
+                if (echo) {
+                    connection.roundTrips.Record(Now() - ReadStamp(message));
+                    client.Send(MakeMessage(messageBytes));
+                }
+            }
+        );
+    }
+
+    const auto deadline {Clock::now() + std::chrono::seconds {10}};
+    while (nConnected < nConnections && Clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds {1});
+    }
+    if (nConnected < nConnections) {
+        std::cerr << "Only " << nConnected << " of " << nConnections
+                  << " connections came up" << std::endl;
+        return 1;
+    }
+
+    measuring = true;
+    const auto start {Clock::now()};
+    if (echo) {
+        for (auto& connection: connections) {
+            for (std::size_t idx {0}; idx < window; ++idx) {
+                connection.client->Send(MakeMessage(messageBytes));
+            }
+        }
+    }
+    std::this_thread::sleep_for(duration);
+    measuring = false;
+    const auto elapsed {
+        std::chrono::duration<double>(Clock::now() - start).count()
+    };
+
+    for (auto& connection: connections) {
+        connection.client->Close();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds {100});
+    if (serverThread.joinable()) {
+        server.Stop();
+    }
+    clientGuard.reset();
+    clientIoc.stop();
+    for (auto& thread: clientThreads) {
+        thread.join();
+    }
+    serverIoc.stop();
+    if (serverThread.joinable()) {
+        serverThread.join();
+    }
+
+    Histogram roundTrips {};
+    std::size_t nReceived {0};
+    std::size_t nBytes {0};
+    for (const auto& connection: connections) {
+        roundTrips.Merge(connection.roundTrips);
+        nReceived += connection.nReceived;
+        nBytes += connection.nBytes;
+    }
+
+    std::cout << "Mode: " << mode << ", " << nConnections << " connections, "
+              << messageBytes << "-byte messages";
+    if (echo) {
+        std::cout << ", window " << window;
+    }
+    std::cout << ", " << nClientThreads << " client thread(s)" << std::endl;
+    std::cout << "Throughput: " << nReceived / elapsed << " messages/s, "
+              << nBytes / elapsed / 1e6 << " MB/s" << std::endl;
+    if (echo) {
+        const auto us = [&roundTrips](double percentile) {
+            return roundTrips.GetValueAtPercentile(percentile) / 1e3;
+        };
+        std::cout << "Round trip (us): p50 " << us(50) << ", p99 " << us(99)
+                  << ", p999 " << us(99.9) << ", max "
+                  << roundTrips.GetMax() / 1e3 << std::endl;
+    }
+    return nReceived > 0 ? 0 : 1;
+}
@@ -0,0 +1,361 @@
+#ifndef NETWORK_MONITOR_COALESCING_STREAM_H
+#define NETWORK_MONITOR_COALESCING_STREAM_H
+
+#include "cpu-clock.h"
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket/teardown.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief Stream layer that can batch many small writes into one.
+ *
+ *  By default every call is forwarded to the next layer untouched. After
+ *  Cork() is called, writes are copied into an internal buffer and complete
+ *  immediately; AsyncFlush() then sends all of them with a single write on the
+ *  next layer. This lets the WebSocket client put several complete frames on
+ *  the wire with one syscall without changing the message boundaries.
+ *
+ *  The stream also counts the bytes that cross it and, on request, the CPU
+ *  time spent in the completion handlers of the layers above: with a
+ *  WebSocket stream on top, that is the framing and compression work.
+ *
+ *  \note Like the next layer, this class is not thread safe. All calls must
+ *        happen on the stream's strand.
+ */
+template <typename NextLayer>
+class CoalescingStream {
+public:
+    using next_layer_type = typename std::remove_reference<NextLayer>::type;
+    using executor_type = typename next_layer_type::executor_type;
+
+    /*! \brief Construct the stream. All arguments go to the next layer.
+     */
+    template <typename... Args>
+    explicit CoalescingStream(Args&&... args)
+        : next_ {std::forward<Args>(args)...}
+    {
+    }
+
+    executor_type get_executor() noexcept
+    {
+        return next_.get_executor();
+    }
+
+    next_layer_type& next_layer() noexcept
+    {
+        return next_;
+    }
+
+    const next_layer_type& next_layer() const noexcept
+    {
+        return next_;
+    }
+
+    /*! \brief Start buffering writes until the next AsyncFlush().
+     */
+    void Cork()
+    {
+        corked_ = true;
+    }
+
+    /*! \brief Whether writes are currently buffered.
+     */
+    bool IsCorked() const
+    {
+        return corked_;
+    }
+
+    /*! \brief Number of bytes waiting for the next flush.
+     */
+    std::size_t GetBufferedBytes() const
+    {
+        return buffer_.size() + backlog_.size();
+    }
+
+    /*! \brief Send all buffered bytes with one write and stop buffering.
+     *
+     *  \param handler Called with the result of the write. Writes issued while
+     *                 the flush is in progress are sent before the handler is
+     *                 called.
+     */
+    template <typename FlushHandler>
+    auto AsyncFlush(FlushHandler&& handler)
+    {
+        return boost::asio::async_initiate<
+            FlushHandler, void (boost::system::error_code)
+        >(
+            [this](auto&& handler) {
+                corked_ = false;
+                flushing_ = true;
+                DoFlush(std::forward<decltype(handler)>(handler));
+            },
+            handler
+        );
+    }
+
+    /*! \brief Bytes read from the next layer so far.
+     *
+     *  \note Safe to call from any thread, like the other counters.
+     */
+    std::uint64_t GetBytesRead() const
+    {
+        return bytesRead_.load(std::memory_order_relaxed);
+    }
+
+    /*! \brief Bytes written to the next layer so far.
+     */
+    std::uint64_t GetBytesWritten() const
+    {
+        return bytesWritten_.load(std::memory_order_relaxed);
+    }
+
+    /*! \brief Start or stop measuring CPU time. It costs two reads of the
+     *         thread CPU clock per completion, so it is off by default.
+     */
+    void SetCpuAccounting(bool enabled)
+    {
+        cpuAccounting_ = enabled;
+    }
+
+    /*! \brief CPU time spent in the read and write completion handlers and
+     *         in the functions passed to Timed(), minus the functions passed
+     *         to Untimed().
+     */
+    std::chrono::nanoseconds GetCpuTime() const
+    {
+        return std::chrono::nanoseconds {
+            cpuTime_.load(std::memory_order_relaxed)
+        };
+    }
+
+    /*! \brief Call function and count its CPU time, for work the layers
+     *         above do outside of a completion handler, e.g. compressing a
+     *         message when a write is started.
+     */
+    template <typename Function>
+    void Timed(Function&& function)
+    {
+        if (!cpuAccounting_ || timing_) {
+            function();
+            return;
+        }
+        timing_ = true;
+        untimed_ = std::chrono::nanoseconds {0};
+        const auto start {GetThreadCpuTime()};
+        function();
+        const auto spent {GetThreadCpuTime() - start - untimed_};
+        timing_ = false;
+        if (spent.count() > 0) {
+            cpuTime_.store(
+                cpuTime_.load(std::memory_order_relaxed) + spent.count(),
+                std::memory_order_relaxed
+            );
+        }
+    }
+
+    /*! \brief Call function and leave its CPU time out of the count, for
+     *         user callbacks invoked from a completion handler.
+     */
+    template <typename Function>
+    void Untimed(Function&& function)
+    {
+        if (!timing_) {
+            function();
+            return;
+        }
+        const auto start {GetThreadCpuTime()};
+        function();
+        untimed_ += GetThreadCpuTime() - start;
+    }
+
+    template <typename MutableBufferSequence, typename ReadHandler>
+    auto async_read_some(
+        const MutableBufferSequence& buffers,
+        ReadHandler&& handler
+    )
+    {
+        return boost::asio::async_initiate<
+            ReadHandler, void (boost::system::error_code, std::size_t)
+        >(
+            [this](auto&& handler, const MutableBufferSequence& buffers) {
+                next_.async_read_some(
+                    buffers,
+                    Account(bytesRead_,
+                            std::forward<decltype(handler)>(handler))
+                );
+            },
+            handler,
+            buffers
+        );
+    }
+
+    template <typename ConstBufferSequence, typename WriteHandler>
+    auto async_write_some(
+        const ConstBufferSequence& buffers,
+        WriteHandler&& handler
+    )
+    {
+        return boost::asio::async_initiate<
+            WriteHandler, void (boost::system::error_code, std::size_t)
+        >(
+            [this](auto&& handler, const ConstBufferSequence& buffers) {
+                if (!corked_ && !flushing_) {
+                    next_.async_write_some(
+                        buffers,
+                        Account(bytesWritten_,
+                                std::forward<decltype(handler)>(handler))
+                    );
+                    return;
+                }
+
+                // While a flush is running the bytes must go after it, so
+                // they land in the backlog instead of the flush buffer.
+                auto& target {flushing_ ? backlog_ : buffer_};
+                const auto nBytes {boost::asio::buffer_size(buffers)};
+                const auto offset {target.size()};
+                target.resize(offset + nBytes);
+                boost::asio::buffer_copy(
+                    boost::asio::buffer(target.data() + offset, nBytes),
+                    buffers
+                );
+                boost::asio::post(
+                    next_.get_executor(),
+                    boost::beast::bind_front_handler(
+                        std::forward<decltype(handler)>(handler),
+                        boost::system::error_code {},
+                        nBytes
+                    )
+                );
+            },
+            handler,
+            buffers
+        );
+    }
+
+private:
+    NextLayer next_;
+
+    // Both buffers keep their capacity between flushes so that a steady
+    // stream of batches does not allocate.
+    std::vector<char> buffer_ {};
+    std::vector<char> backlog_ {};
+    bool corked_ {false};
+    bool flushing_ {false};
+
+    // Written on the strand only, read from anywhere.
+    std::atomic<std::uint64_t> bytesRead_ {0};
+    std::atomic<std::uint64_t> bytesWritten_ {0};
+    std::atomic<std::int64_t> cpuTime_ {0};
+    bool cpuAccounting_ {false};
+    bool timing_ {false};
+    std::chrono::nanoseconds untimed_ {0};
+
+    static void Add(std::atomic<std::uint64_t>& counter, std::size_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n,
+                      std::memory_order_relaxed);
+    }
+
+    // Wrap a completion handler of the next layer so that it counts the
+    // bytes transferred and times the handler. The wrapper keeps the
+    // handler's executor, so it still completes on the strand.
+    template <typename Handler>
+    auto Account(std::atomic<std::uint64_t>& counter, Handler&& handler)
+    {
+        const auto executor {boost::asio::get_associated_executor(
+            handler, next_.get_executor()
+        )};
+        return boost::asio::bind_executor(
+            executor,
+            [this, &counter, handler = std::forward<Handler>(handler)](
+                boost::system::error_code ec,
+                std::size_t nBytes
+            ) mutable {
+                Add(counter, nBytes);
+                Timed([&]() {
+                    std::move(handler)(ec, nBytes);
+                });
+            }
+        );
+    }
+
+    template <typename FlushHandler>
+    void DoFlush(FlushHandler&& handler)
+    {
+        if (buffer_.empty()) {
+            flushing_ = false;
+            boost::asio::post(
+                next_.get_executor(),
+                boost::beast::bind_front_handler(
+                    std::forward<FlushHandler>(handler),
+                    boost::system::error_code {}
+                )
+            );
+            return;
+        }
+        boost::asio::async_write(
+            next_,
+            boost::asio::buffer(buffer_),
+            boost::beast::bind_front_handler(
+                [this](auto&& handler,
+                       boost::system::error_code ec,
+                       std::size_t nBytes) {
+                    Add(bytesWritten_, nBytes);
+                    buffer_.clear();
+                    buffer_.swap(backlog_);
+                    if (ec) {
+                        buffer_.clear();
+                        flushing_ = false;
+                        handler(ec);
+                        return;
+                    }
+                    DoFlush(std::move(handler));
+                },
+                std::forward<FlushHandler>(handler)
+            )
+        );
+    }
+};
+
+/*! \brief Let the WebSocket stream close the socket beneath the coalescing
+ *         layer.
+ */
+template <typename NextLayer>
+void teardown(
+    boost::beast::role_type role,
+    CoalescingStream<NextLayer>& stream,
+    boost::system::error_code& ec
+)
+{
+    using boost::beast::websocket::teardown;
+    teardown(role, stream.next_layer(), ec);
+}
+
+/*! \brief Asynchronous version of teardown().
+ */
+template <typename NextLayer, typename TeardownHandler>
+void async_teardown(
+    boost::beast::role_type role,
+    CoalescingStream<NextLayer>& stream,
+    TeardownHandler&& handler
+)
+{
+    using boost::beast::websocket::async_teardown;
+    async_teardown(role, stream.next_layer(),
+                   std::forward<TeardownHandler>(handler));
+}
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_COALESCING_STREAM_H
@@ -0,0 +1,69 @@
+#ifndef NETWORK_MONITOR_COMPRESSION_OPTIONS_H
+#define NETWORK_MONITOR_COMPRESSION_OPTIONS_H
+
+#include <boost/beast/core/role.hpp>
+#include <boost/beast/websocket/option.hpp>
+
+namespace NetworkMonitor {
+
+/*! \brief permessage-deflate settings (RFC 7692) of a WebSocket endpoint.
+ *
+ *  Compression is only used if both ends offer it. Larger windows and memory
+ *  levels compress better but cost more memory per connection; without
+ *  context takeover every message is compressed on its own, which saves the
+ *  memory of the sliding window between messages but loses the redundancy
+ *  across them, usually the bulk of it for small JSON messages.
+ */
+struct CompressionOptions {
+    bool enabled {false};
+
+    /*! \brief Base-2 log of the LZ77 window used by the client, 9 to 15.
+     */
+    int clientMaxWindowBits {15};
+
+    /*! \brief Base-2 log of the LZ77 window used by the server, 9 to 15.
+     */
+    int serverMaxWindowBits {15};
+
+    /*! \brief Reset the client's compression context after each message.
+     */
+    bool clientNoContextTakeover {false};
+
+    /*! \brief Ask the server to reset its context after each message.
+     */
+    bool serverNoContextTakeover {false};
+
+    /*! \brief Deflate compression level, 0 (none) to 9 (smallest).
+     */
+    int level {8};
+
+    /*! \brief Deflate memory level, 1 (least memory) to 9 (fastest).
+     */
+    int memoryLevel {4};
+};
+
+/*! \brief Translate CompressionOptions into the Beast stream option of a
+ *         client or a server.
+ */
+inline boost::beast::websocket::permessage_deflate MakePermessageDeflate(
+    const CompressionOptions& options,
+    boost::beast::role_type role
+)
+{
+    boost::beast::websocket::permessage_deflate pmd {};
+    pmd.client_enable = options.enabled &&
+                        role == boost::beast::role_type::client;
+    pmd.server_enable = options.enabled &&
+                        role == boost::beast::role_type::server;
+    pmd.client_max_window_bits = options.clientMaxWindowBits;
+    pmd.server_max_window_bits = options.serverMaxWindowBits;
+    pmd.client_no_context_takeover = options.clientNoContextTakeover;
+    pmd.server_no_context_takeover = options.serverNoContextTakeover;
+    pmd.compLevel = options.level;
+    pmd.memLevel = options.memoryLevel;
+    return pmd;
+}
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_COMPRESSION_OPTIONS_H
@@ -0,0 +1,251 @@
+#include "connection-pool.h"
+
+#include "logging.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+#if defined(_WIN32)
+// Asio, through connection-pool.h, may have defined these already.
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace NetworkMonitor {
+
+namespace {
+
+// How long the destructor waits for the close handshakes.
+constexpr std::chrono::milliseconds kCloseTimeout {1000};
+
+void PinCurrentThread(int cpu)
+{
+#if defined(_WIN32)
+    // The mask only reaches the CPUs of the current processor group.
+    constexpr int kMaxCpus {static_cast<int>(sizeof(DWORD_PTR) * 8)};
+    if (cpu >= kMaxCpus) {
+        NM_LOG_WARNING("CPU is outside the processor group of the process",
+                       std::to_string(cpu));
+        return;
+    }
+    const DWORD_PTR mask {DWORD_PTR {1} << cpu};
+    if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0) {
+        NM_LOG_WARNING("Could not pin worker thread",
+            boost::system::error_code {static_cast<int>(GetLastError()),
+                                       boost::system::system_category()},
+            std::to_string(cpu));
+    }
+#elif defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    const auto result {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)
+    };
+    if (result != 0) {
+        NM_LOG_WARNING("Could not pin worker thread",
+            boost::system::error_code {result,
+                                       boost::system::generic_category()},
+            std::to_string(cpu));
+    }
+#else
+    NM_LOG_WARNING("CPU affinity is not supported on this platform",
+                   std::to_string(cpu));
+#endif
+}
+
+} // namespace
+
+ConnectionPool::ConnectionPool(
+    ConnectionPoolOptions options
+) : options_ {std::move(options)},
+    queue_ {options_.queueCapacity}
+{
+    if (options_.nThreads == 0) {
+        options_.nThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const std::size_t nContexts {
+        options_.ioContextPerThread ? options_.nThreads : 1
+    };
+    for (std::size_t idx {0}; idx < nContexts; ++idx) {
+        // With a single worker per context, asio can skip its locking.
+        const int concurrencyHint {
+            options_.ioContextPerThread ? 1 :
+            static_cast<int>(options_.nThreads)
+        };
+        contexts_.push_back(
+            std::make_unique<boost::asio::io_context>(concurrencyHint)
+        );
+        workGuards_.push_back(
+            boost::asio::make_work_guard(contexts_.back()->get_executor())
+        );
+    }
+    for (std::size_t idx {0}; idx < options_.nThreads; ++idx) {
+        workers_.emplace_back([this, idx]() {
+            RunWorker(idx);
+        });
+    }
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    // Close the connections cleanly while the workers are still running.
+    for (auto& connection: connections_) {
+        connection->Close([this](auto /*ec*/) {
+            ++nClosed_;
+        });
+    }
+    const auto deadline {std::chrono::steady_clock::now() + kCloseTimeout};
+    while (nClosed_ < connections_.size() &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds {1});
+    }
+
+    workGuards_.clear();
+    for (auto& context: contexts_) {
+        context->stop();
+    }
+    for (auto& worker: workers_) {
+        worker.join();
+    }
+    // The connections must go before the io_contexts they live on.
+    connections_.clear();
+}
+
+std::size_t ConnectionPool::AddConnection(
+    const std::string& url,
+    const std::string& endpoint,
+    const std::string& port,
+    std::function<void (boost::system::error_code)> onConnect,
+    std::function<void (boost::system::error_code)> onDisconnect
+)
+{
+    const auto id {connections_.size()};
+    auto& context {*contexts_[id % contexts_.size()]};
+    connections_.push_back(
+        std::make_unique<WebSocketClient>(url, endpoint, port, context,
+                                          options_.clientOptions)
+    );
+    connections_.back()->Connect(
+        std::move(onConnect),
+        [this, id](auto /*ec*/, auto&& payload) {
+            Enqueue(id, std::move(payload));
+        },
+        std::move(onDisconnect)
+    );
+    return id;
+}
+
+WebSocketClient& ConnectionPool::GetConnection(std::size_t connection)
+{
+    return *connections_.at(connection);
+}
+
+bool ConnectionPool::TryPop(PooledMessage& message)
+{
+    return queue_.TryPop(message);
+}
+
+std::size_t ConnectionPool::GetThreadCount() const
+{
+    return workers_.size();
+}
+
+std::size_t ConnectionPool::GetConnectionCount() const
+{
+    return connections_.size();
+}
+
+std::size_t ConnectionPool::GetMessageCount() const
+{
+    return nMessages_.load(std::memory_order_relaxed);
+}
+
+std::size_t ConnectionPool::GetDroppedCount() const
+{
+    return nDropped_.load(std::memory_order_relaxed);
+}
+
+void ConnectionPool::RunWorker(std::size_t worker)
+{
+    if (!options_.cpuAffinity.empty()) {
+        PinCurrentThread(
+            options_.cpuAffinity[worker % options_.cpuAffinity.size()]
+        );
+    }
+    contexts_[worker % contexts_.size()]->run();
+}
+
+void ConnectionPool::Enqueue(std::size_t connection, std::string&& payload)
+{
+    // The consumer is behind. Waiting here would hold up the worker, and
+    // every other connection on its io_context with it: drop the message.
+    PooledMessage message {connection, std::move(payload)};
+    if (!queue_.TryPush(message)) {
+        nDropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    nMessages_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<int> ParseCpuList(
+    const std::string& text,
+    boost::system::error_code& ec
+)
+{
+    ec = {};
+    std::vector<int> cpus {};
+    std::size_t pos {0};
+    const auto number = [&text, &pos](int& value) {
+        const auto begin {pos};
+        value = 0;
+        while (pos < text.size() &&
+               std::isdigit(static_cast<unsigned char>(text[pos]))) {
+            value = value * 10 + (text[pos] - '0');
+            if (value > 4096) {
+                return false;
+            }
+            ++pos;
+        }
+        return pos != begin;
+    };
+    while (pos < text.size()) {
+        int first {0};
+        int last {0};
+        if (!number(first)) {
+            break;
+        }
+        last = first;
+        if (pos < text.size() && text[pos] == '-') {
+            ++pos;
+            if (!number(last) || last < first) {
+                break;
+            }
+        }
+        for (int cpu {first}; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        if (pos == text.size()) {
+            return cpus;
+        }
+        if (text[pos] != ',') {
+            break;
+        }
+        ++pos;
+    }
+    ec = boost::system::errc::make_error_code(
+        boost::system::errc::invalid_argument
+    );
+    return {};
+}
+
+} // namespace NetworkMonitor
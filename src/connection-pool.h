@@ -0,0 +1,170 @@
+#ifndef NETWORK_MONITOR_CONNECTION_POOL_H
+#define NETWORK_MONITOR_CONNECTION_POOL_H
+
+#include "mpsc-queue.h"
+#include "websocket-client.h"
+
+#include <boost/asio.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief Configuration of a ConnectionPool.
+ */
+struct ConnectionPoolOptions {
+    /*! \brief Number of worker threads. 0 means one per hardware thread.
+     */
+    std::size_t nThreads {0};
+
+    /*! \brief Give every worker its own io_context instead of sharing one.
+     *
+     *  A shared io_context balances the load between the workers by itself.
+     *  One io_context per worker avoids contention on its queue, at the
+     *  price of a fixed assignment of connections to threads.
+     */
+    bool ioContextPerThread {false};
+
+    /*! \brief CPUs to pin the workers to. Worker i runs on
+     *         cpuAffinity[i % cpuAffinity.size()]. Empty: no pinning.
+     *
+     *  \note Pinning is supported on Linux and Windows. Elsewhere it is
+     *        ignored with a warning.
+     */
+    std::vector<int> cpuAffinity {};
+
+    /*! \brief Capacity of the queue between the connections and the
+     *         consumer. Messages that arrive while it is full are dropped
+     *         and counted, see ConnectionPool::GetDroppedCount(): a slow
+     *         consumer must not stall the workers, and with them every
+     *         connection they serve.
+     */
+    std::size_t queueCapacity {64 * 1024};
+
+    /*! \brief Timeouts and reconnection policy of every connection.
+     */
+    WebSocketClientOptions clientOptions {};
+};
+
+/*! \brief A message received by one of the connections of a pool.
+ */
+struct PooledMessage {
+    std::size_t connection {0};
+    std::string payload {};
+};
+
+/*! \brief Many WebSocket connections served by a pool of worker threads,
+ *         with all their messages funnelled to a single consumer.
+ *
+ *  The workers run the io_context(s) that the connections live on. Each
+ *  received message is moved, without copying, into a lock-free MPSC queue
+ *  that the consumer drains with Pop().
+ */
+class ConnectionPool {
+public:
+    /*! \brief Construct the pool and start its workers.
+     */
+    explicit ConnectionPool(ConnectionPoolOptions options = {});
+
+    /*! \brief Close all connections and join the workers.
+     */
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /*! \brief Open a new connection.
+     *
+     *  Connections are spread round-robin over the io_contexts.
+     *
+     *  \param onConnect    Called on a worker thread when the connection
+     *                      succeeds or fails.
+     *  \param onDisconnect Called on a worker thread when the connection is
+     *                      closed.
+     *  \returns the id of the connection, as found in PooledMessage.
+     *
+     *  \note Call this from the thread that owns the pool.
+     */
+    std::size_t AddConnection(
+        const std::string& url,
+        const std::string& endpoint,
+        const std::string& port,
+        std::function<void (boost::system::error_code)> onConnect = nullptr,
+        std::function<void (boost::system::error_code)> onDisconnect = nullptr
+    );
+
+    /*! \brief Access a connection, for example to Send() on it.
+     */
+    WebSocketClient& GetConnection(std::size_t connection);
+
+    /*! \brief Take the next message, waiting up to timeout for one.
+     *
+     *  \returns false if no message arrived in time.
+     *
+     *  \note Always call this from the same thread: the consumer.
+     */
+    template <typename Rep, typename Period>
+    bool Pop(
+        PooledMessage& message,
+        std::chrono::duration<Rep, Period> timeout
+    )
+    {
+        return queue_.Pop(message, timeout);
+    }
+
+    /*! \brief Take the next message if there is one.
+     */
+    bool TryPop(PooledMessage& message);
+
+    std::size_t GetThreadCount() const;
+    std::size_t GetConnectionCount() const;
+
+    /*! \brief Number of messages received by all the connections so far.
+     */
+    std::size_t GetMessageCount() const;
+
+    /*! \brief Number of messages dropped so far because the queue was full.
+     *
+     *  They are not included in GetMessageCount().
+     */
+    std::size_t GetDroppedCount() const;
+
+private:
+    using WorkGuard = boost::asio::executor_work_guard<
+        boost::asio::io_context::executor_type
+    >;
+
+    ConnectionPoolOptions options_;
+    std::vector<std::unique_ptr<boost::asio::io_context>> contexts_ {};
+    std::vector<WorkGuard> workGuards_ {};
+    std::vector<std::thread> workers_ {};
+    std::vector<std::unique_ptr<WebSocketClient>> connections_ {};
+    MpscQueue<PooledMessage> queue_;
+    std::atomic<std::size_t> nMessages_ {0};
+    std::atomic<std::size_t> nDropped_ {0};
+    std::atomic<std::size_t> nClosed_ {0};
+
+    void RunWorker(std::size_t worker);
+    void Enqueue(std::size_t connection, std::string&& payload);
+};
+
+/*! \brief Parse a CPU list such as "0-3,8,10-11".
+ *
+ *  \returns an empty list, and sets ec, if the text is malformed.
+ */
+std::vector<int> ParseCpuList(
+    const std::string& text,
+    boost::system::error_code& ec
+);
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_CONNECTION_POOL_H
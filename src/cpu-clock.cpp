@@ -0,0 +1,45 @@
+#include "cpu-clock.h"
+
+// Kept out of the header: windows.h must not reach the translation units
+// that include Asio, which refuses to follow winsock.h.
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace NetworkMonitor {
+
+std::chrono::nanoseconds GetThreadCpuTime()
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel,
+                        &user)) {
+        return std::chrono::nanoseconds {0};
+    }
+    const auto ticks = [](const FILETIME& time) {
+        return (static_cast<long long>(time.dwHighDateTime) << 32) |
+               time.dwLowDateTime;
+    };
+    // FILETIME counts 100 ns ticks.
+    return std::chrono::nanoseconds {(ticks(kernel) + ticks(user)) * 100};
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec now {};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+        return std::chrono::nanoseconds {0};
+    }
+    return std::chrono::seconds {now.tv_sec} +
+           std::chrono::nanoseconds {now.tv_nsec};
+#else
+    return std::chrono::nanoseconds {0};
+#endif
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,20 @@
+#ifndef NETWORK_MONITOR_CPU_CLOCK_H
+#define NETWORK_MONITOR_CPU_CLOCK_H
+
+#include <chrono>
+
+namespace NetworkMonitor {
+
+/*! \brief CPU time consumed so far by the calling thread.
+ *
+ *  Unlike a wall clock, it does not advance while the thread waits, so the
+ *  difference of two readings is the work done in between. Its resolution is
+ *  that of the scheduler accounting: fine on Linux, about 15 ms on Windows.
+ *
+ *  \returns 0 if the platform has no per-thread CPU clock.
+ */
+std::chrono::nanoseconds GetThreadCpuTime();
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_CPU_CLOCK_H
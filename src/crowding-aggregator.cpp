@@ -0,0 +1,315 @@
+#include "crowding-aggregator.h"
+
+#include "csr.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace NetworkMonitor {
+
+namespace {
+
+constexpr std::size_t kCacheLineBytes {64};
+constexpr std::size_t kSlotsPerLine {kCacheLineBytes / sizeof(std::int64_t)};
+
+// Backoff steps spent spinning, doubling the pauses each time, before a
+// waiting thread starts yielding its time slice instead.
+constexpr unsigned kSpinSteps {6};
+
+void CpuRelax()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Wait a little longer at each call. On a single core only yielding lets
+// the thread we wait for make progress, so spinning is kept short.
+void Backoff(unsigned& step)
+{
+    if (step < kSpinSteps) {
+        for (unsigned idx {0}; idx < (1u << step); ++idx) {
+            CpuRelax();
+        }
+        ++step;
+        return;
+    }
+    std::this_thread::yield();
+}
+
+// Allocate n zeroed atomics and return the first cache-line aligned one.
+template <typename T>
+std::atomic<T>* AllocateAligned(
+    std::size_t n,
+    std::unique_ptr<std::atomic<T>[]>& storage
+)
+{
+    storage.reset(new std::atomic<T>[n + kSlotsPerLine]());
+    auto address {reinterpret_cast<std::uintptr_t>(storage.get())};
+    const auto misalignment {address % kCacheLineBytes};
+    if (misalignment != 0) {
+        address += kCacheLineBytes - misalignment;
+    }
+    return reinterpret_cast<std::atomic<T>*>(address);
+}
+
+std::size_t GetHomeShard(std::size_t nShards)
+{
+    // Threads are spread over the shards in the order they first write.
+    static std::atomic<std::size_t> nextShard {0};
+    thread_local const std::size_t shard {nextShard.fetch_add(1)};
+    return shard % nShards;
+}
+
+} // namespace
+
+CrowdingAggregator::CrowdingAggregator(
+    const NetworkLayout& layout,
+    std::size_t nWriters
+) : layout_ {layout},
+    nShards_ {nWriters > 0 ? nWriters :
+              std::max<std::size_t>(1, std::thread::hardware_concurrency())},
+    // Stations, then segments, then the number of events.
+    nCounters_ {layout.GetStationCount() + layout.GetEdgeCount() + 1}
+{
+    sequences_ = AllocateAligned(nShards_ * kSlotsPerLine, sequenceStorage_);
+    counterStride_ = (nCounters_ + kSlotsPerLine - 1) /
+                     kSlotsPerLine * kSlotsPerLine;
+    counters_ = AllocateAligned(nShards_ * counterStride_, counterStorage_);
+
+    std::vector<std::pair<StationIndex, EdgeIndex>> incoming {};
+    for (const auto& edge: layout_.GetAllEdges()) {
+        incoming.push_back({edge.to, layout_.GetEdgeIndex(edge)});
+    }
+    BuildCsr(layout_.GetStationCount(), incoming, incomingOffsets_,
+             incoming_);
+}
+
+CrowdingAggregator::~CrowdingAggregator() = default;
+
+bool CrowdingAggregator::Apply(const NetworkEvent& event)
+{
+    const auto nStations {static_cast<std::uint32_t>(
+        layout_.GetStationCount()
+    )};
+    const auto eventsCounter {static_cast<std::uint32_t>(nCounters_ - 1)};
+    const auto station {layout_.FindStation(event.stationId.View())};
+    if (station == kInvalidIndex) {
+        return false;
+    }
+
+    Update updates[2] {};
+    switch (event.type) {
+    case NetworkEventType::PassengerIn:
+    case NetworkEventType::PassengerOut: {
+        const bool in {event.type == NetworkEventType::PassengerIn};
+        updates[0] = {station, in ? 1 : -1};
+        break;
+    }
+    case NetworkEventType::TrainDeparture: {
+        const auto route {layout_.FindRoute(event.routeId.View())};
+        const auto edges {layout_.GetEdges(station)};
+        const auto edge {std::find_if(edges.begin(), edges.end(),
+            [route](const Edge& edge) { return edge.route == route; }
+        )};
+        if (edge == edges.end()) {
+            return false;
+        }
+        updates[0] = {
+            nStations + layout_.GetEdgeIndex(*edge),
+            static_cast<std::int64_t>(event.passengers)
+        };
+        break;
+    }
+    case NetworkEventType::TrainArrival: {
+        const auto route {layout_.FindRoute(event.routeId.View())};
+        const auto begin {incoming_.data() + incomingOffsets_[station]};
+        const auto end {incoming_.data() + incomingOffsets_[station + 1]};
+        const auto edge {std::find_if(begin, end,
+            [this, route](EdgeIndex edge) {
+                return layout_.GetAllEdges()[edge].route == route;
+            }
+        )};
+        if (edge == end) {
+            return false;
+        }
+        updates[0] = {
+            nStations + *edge,
+            -static_cast<std::int64_t>(event.passengers)
+        };
+        break;
+    }
+    default:
+        return false;
+    }
+    updates[1] = {eventsCounter, 1};
+    ApplyUpdates(updates, 2);
+    return true;
+}
+
+void CrowdingAggregator::AddToStation(StationIndex station, std::int64_t delta)
+{
+    const Update update {station, delta};
+    ApplyUpdates(&update, 1);
+}
+
+void CrowdingAggregator::AddToSegment(EdgeIndex segment, std::int64_t delta)
+{
+    const Update update {
+        static_cast<std::uint32_t>(layout_.GetStationCount() + segment),
+        delta
+    };
+    ApplyUpdates(&update, 1);
+}
+
+void CrowdingAggregator::GetSnapshot(Snapshot& snapshot) const
+{
+    // Copy each shard into a scratch area first: an optimistic read that
+    // fails half way must not leave anything behind. The scratch area is
+    // per thread, so that concurrent readers do not share it.
+    thread_local std::vector<std::int64_t> copy {};
+    copy.resize(nCounters_);
+
+    const auto nStations {layout_.GetStationCount()};
+    snapshot.stations.assign(nStations, 0);
+    snapshot.segments.assign(nCounters_ - 1 - nStations, 0);
+    std::int64_t nEvents {0};
+    for (std::size_t shard {0}; shard < nShards_; ++shard) {
+        ReadShard(shard, copy.data());
+        for (std::size_t idx {0}; idx < nStations; ++idx) {
+            snapshot.stations[idx] += copy[idx];
+        }
+        for (std::size_t idx {nStations}; idx < nCounters_ - 1; ++idx) {
+            snapshot.segments[idx - nStations] += copy[idx];
+        }
+        nEvents += copy[nCounters_ - 1];
+    }
+    snapshot.nEvents = static_cast<std::uint64_t>(nEvents);
+}
+
+std::int64_t CrowdingAggregator::GetStationCount(StationIndex station) const
+{
+    // A single counter is always consistent: no need for the seqlock.
+    std::int64_t total {0};
+    for (std::size_t shard {0}; shard < nShards_; ++shard) {
+        total += counters_[shard * counterStride_ + station].load(
+            std::memory_order_relaxed
+        );
+    }
+    return total;
+}
+
+std::int64_t CrowdingAggregator::GetSegmentCount(EdgeIndex segment) const
+{
+    return GetStationCount(
+        static_cast<StationIndex>(layout_.GetStationCount() + segment)
+    );
+}
+
+void CrowdingAggregator::ApplyUpdates(
+    const Update* updates,
+    std::size_t nUpdates
+)
+{
+    // Take the first free shard, starting from this thread's own. Only
+    // writers lock shards, so they are all busy only when there are more
+    // writer threads than shards: back off after each fruitless round.
+    const auto home {GetHomeShard(nShards_)};
+    auto shard {home};
+    std::uint64_t sequence {0};
+    unsigned step {0};
+    while (!TryLockShard(shard, sequence)) {
+        shard = (shard + 1) % nShards_;
+        if (shard == home) {
+            Backoff(step);
+        }
+    }
+
+    // We own the shard: plain loads and stores, no read-modify-write needed.
+    auto counters {counters_ + shard * counterStride_};
+    for (std::size_t idx {0}; idx < nUpdates; ++idx) {
+        auto& counter {counters[updates[idx].counter]};
+        counter.store(
+            counter.load(std::memory_order_relaxed) + updates[idx].delta,
+            std::memory_order_relaxed
+        );
+    }
+    sequences_[shard * kSlotsPerLine].store(
+        sequence + 2, std::memory_order_release
+    );
+}
+
+bool CrowdingAggregator::TryLockShard(
+    std::size_t shard,
+    std::uint64_t& sequence
+)
+{
+    auto& current {sequences_[shard * kSlotsPerLine]};
+    sequence = current.load(std::memory_order_relaxed);
+    if ((sequence & 1) != 0 ||
+        !current.compare_exchange_strong(sequence, sequence + 1,
+                                         std::memory_order_acquire)) {
+        return false;
+    }
+    // Readers that see any of our counter stores must also see the odd
+    // sequence number.
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+}
+
+void CrowdingAggregator::ReadShard(std::size_t shard, std::int64_t* copy) const
+{
+    const auto& sequence {sequences_[shard * kSlotsPerLine]};
+    const auto counters {counters_ + shard * counterStride_};
+    const auto read = [this, counters, copy]() {
+        for (std::size_t idx {0}; idx < nCounters_; ++idx) {
+            copy[idx] = counters[idx].load(std::memory_order_relaxed);
+        }
+    };
+
+    // A writer holds a shard for a handful of stores, so a retry soon
+    // succeeds. Back off between attempts rather than hammer the line the
+    // writer is working on.
+    unsigned step {0};
+    while (true) {
+        const auto before {sequence.load(std::memory_order_acquire)};
+        if ((before & 1) == 0) {
+            read();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                return;
+            }
+        }
+        Backoff(step);
+    }
+}
+
+std::function<void (boost::system::error_code, boost::beast::string_view)>
+MakeCrowdingHandler(CrowdingAggregator& aggregator)
+{
+    // std::function needs a copyable target: share one parser between the
+    // copies of this handler.
+    auto parser {std::make_shared<NetworkEventParser>()};
+    return [parser, &aggregator](auto ec, auto message) {
+        if (ec) {
+            return;
+        }
+        parser->Feed(message, [&aggregator](auto ec, const auto& event) {
+            if (!ec) {
+                aggregator.Apply(event);
+            }
+        });
+    };
+}
+
+} // namespace NetworkMonitor
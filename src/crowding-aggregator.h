@@ -0,0 +1,148 @@
+#ifndef NETWORK_MONITOR_CROWDING_AGGREGATOR_H
+#define NETWORK_MONITOR_CROWDING_AGGREGATOR_H
+
+#include "network-event-parser.h"
+#include "network-layout.h"
+
+#include <boost/beast/core/string.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief Live passenger counts per station and per route segment.
+ *
+ *  Updates land in one of several shards. Each shard holds a full set of
+ *  counters, starts on its own cache line and is guarded by a sequence
+ *  number (a seqlock): a writer makes the number odd, updates the counters
+ *  and makes it even again. Each writer thread starts from a shard of its
+ *  own and, should it find it busy, moves on to the next one. With at least
+ *  as many shards as writer threads, writers do not wait for each other.
+ *  A count is the sum of the counters of all shards.
+ *
+ *  Readers copy each shard optimistically and retry, backing off, if its
+ *  sequence number moved. They never write to the shards, so they never
+ *  stop the writers; under heavy write traffic a snapshot takes longer.
+ *
+ *  Station counters are indexed by StationIndex, segment counters by the
+ *  EdgeIndex of the layout edge.
+ */
+class CrowdingAggregator {
+public:
+    /*! \brief A consistent copy of all the counters.
+     *
+     *  Every event is either fully in the snapshot or not at all.
+     */
+    struct Snapshot {
+        std::vector<std::int64_t> stations {};
+        std::vector<std::int64_t> segments {};
+        std::uint64_t nEvents {0};
+    };
+
+    /*! \brief Construct the aggregator.
+     *
+     *  \param layout   The network. It must outlive the aggregator.
+     *  \param nWriters Number of threads that update the counters. Each one
+     *                  gets a shard of its own. Defaults to the number of
+     *                  hardware threads.
+     */
+    explicit CrowdingAggregator(
+        const NetworkLayout& layout,
+        std::size_t nWriters = 0
+    );
+
+    ~CrowdingAggregator();
+
+    CrowdingAggregator(const CrowdingAggregator&) = delete;
+    CrowdingAggregator& operator=(const CrowdingAggregator&) = delete;
+
+    /*! \brief Apply a network event.
+     *
+     *  - Passenger in/out: +1/-1 on the station.
+     *  - Train departure: the passengers board the segment that leaves the
+     *    station on the route.
+     *  - Train arrival: the passengers leave the segment that reaches the
+     *    station on the route.
+     *
+     *  \returns false if the event references an unknown station, route or
+     *           segment. Nothing is counted in that case.
+     *
+     *  \note This function is thread safe. It never waits for readers, nor
+     *        for other writers as long as there are no more writer threads
+     *        than shards.
+     */
+    bool Apply(const NetworkEvent& event);
+
+    /*! \brief Add to the count of one station.
+     */
+    void AddToStation(StationIndex station, std::int64_t delta);
+
+    /*! \brief Add to the count of one route segment.
+     */
+    void AddToSegment(EdgeIndex segment, std::int64_t delta);
+
+    /*! \brief Take a consistent snapshot of all counters.
+     *
+     *  \param snapshot Filled in. Its vectors are reused between calls, and
+     *                  the scratch space is kept per thread, so a reader
+     *                  that reuses its snapshot does not allocate.
+     */
+    void GetSnapshot(Snapshot& snapshot) const;
+
+    /*! \brief Current count of one station.
+     */
+    std::int64_t GetStationCount(StationIndex station) const;
+
+    /*! \brief Current count of one route segment.
+     */
+    std::int64_t GetSegmentCount(EdgeIndex segment) const;
+
+private:
+    // A delta to one counter. Updates are applied in groups so that an event
+    // that touches several counters shows up in one piece.
+    struct Update {
+        std::uint32_t counter;
+        std::int64_t delta;
+    };
+
+    const NetworkLayout& layout_;
+    std::size_t nShards_;
+    std::size_t nCounters_;
+
+    // Shard s has its sequence number at sequences_[s * kSlotsPerLine] and
+    // its counters at counters_[s * counterStride_]. Both arrays are aligned
+    // by hand so that no two shards share a cache line.
+    std::unique_ptr<std::atomic<std::uint64_t>[]> sequenceStorage_;
+    std::atomic<std::uint64_t>* sequences_;
+    std::size_t counterStride_;
+    std::unique_ptr<std::atomic<std::int64_t>[]> counterStorage_;
+    std::atomic<std::int64_t>* counters_;
+
+    // Edges that reach each station, in CSR form, to find the segment a train
+    // arrives on.
+    std::vector<std::uint32_t> incomingOffsets_ {};
+    std::vector<EdgeIndex> incoming_ {};
+
+    void ApplyUpdates(const Update* updates, std::size_t nUpdates);
+    bool TryLockShard(std::size_t shard, std::uint64_t& sequence);
+    void ReadShard(std::size_t shard, std::int64_t* copy) const;
+};
+
+/*! \brief Make a message handler for WebSocketClient::ConnectView() that
+ *         parses every message and applies its events to the aggregator.
+ *
+ *  Each handler has its own parser, so make one per connection. The
+ *  aggregator must outlive the handler.
+ */
+std::function<void (boost::system::error_code, boost::beast::string_view)>
+MakeCrowdingHandler(CrowdingAggregator& aggregator);
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_CROWDING_AGGREGATOR_H
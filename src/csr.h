@@ -0,0 +1,44 @@
+#ifndef NETWORK_MONITOR_CSR_H
+#define NETWORK_MONITOR_CSR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief Sort (key, value) pairs by key into CSR offsets and values.
+ *
+ *  The values of key k end up in values[offsets[k]] to
+ *  values[offsets[k + 1]]. Stable: values with the same key keep their
+ *  relative order.
+ *
+ *  \note Internal helper of the layout, the route graph and the crowding
+ *        aggregator.
+ */
+template <typename T>
+void BuildCsr(
+    std::size_t nKeys,
+    const std::vector<std::pair<std::uint32_t, T>>& entries,
+    std::vector<std::uint32_t>& offsets,
+    std::vector<T>& values
+)
+{
+    offsets.assign(nKeys + 1, 0);
+    for (const auto& entry: entries) {
+        ++offsets[entry.first + 1];
+    }
+    for (std::size_t idx {1}; idx < offsets.size(); ++idx) {
+        offsets[idx] += offsets[idx - 1];
+    }
+    std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    values.resize(entries.size());
+    for (const auto& entry: entries) {
+        values[cursor[entry.first]++] = entry.second;
+    }
+}
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_CSR_H
@@ -0,0 +1,53 @@
+#include "dns-cache.h"
+
+namespace NetworkMonitor {
+
+DnsCache& DnsCache::Get()
+{
+    static DnsCache cache {};
+    return cache;
+}
+
+bool DnsCache::Find(
+    const std::string& host,
+    const std::string& port,
+    std::vector<boost::asio::ip::tcp::endpoint>& endpoints
+)
+{
+    std::lock_guard<std::mutex> lock {mutex_};
+    const auto entry {entries_.find({host, port})};
+    if (entry == entries_.end()) {
+        return false;
+    }
+    if (entry->second.expiry <= Clock::now()) {
+        entries_.erase(entry);
+        return false;
+    }
+    endpoints = entry->second.endpoints;
+    return true;
+}
+
+void DnsCache::Store(
+    const std::string& host,
+    const std::string& port,
+    std::vector<boost::asio::ip::tcp::endpoint> endpoints,
+    Clock::duration ttl
+)
+{
+    std::lock_guard<std::mutex> lock {mutex_};
+    entries_[{host, port}] = {std::move(endpoints), Clock::now() + ttl};
+}
+
+void DnsCache::Invalidate(const std::string& host, const std::string& port)
+{
+    std::lock_guard<std::mutex> lock {mutex_};
+    entries_.erase({host, port});
+}
+
+void DnsCache::Clear()
+{
+    std::lock_guard<std::mutex> lock {mutex_};
+    entries_.clear();
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,71 @@
+#ifndef NETWORK_MONITOR_DNS_CACHE_H
+#define NETWORK_MONITOR_DNS_CACHE_H
+
+#include <boost/asio/ip/tcp.hpp>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief Process-wide cache of resolved endpoints, with a time to live.
+ *
+ *  Reconnecting clients look their server up here first, so that recovering
+ *  from a dropped connection does not wait for the resolver. Entries are
+ *  shared between all the clients that talk to the same host and port.
+ *
+ *  \note This class is thread safe.
+ */
+class DnsCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /*! \brief The cache used by all WebSocketClient instances.
+     */
+    static DnsCache& Get();
+
+    /*! \brief Look up the endpoints of a host and port.
+     *
+     *  \returns false if there is no entry or it has expired.
+     */
+    bool Find(
+        const std::string& host,
+        const std::string& port,
+        std::vector<boost::asio::ip::tcp::endpoint>& endpoints
+    );
+
+    /*! \brief Store the endpoints of a host and port until now + ttl.
+     */
+    void Store(
+        const std::string& host,
+        const std::string& port,
+        std::vector<boost::asio::ip::tcp::endpoint> endpoints,
+        Clock::duration ttl
+    );
+
+    /*! \brief Drop an entry, for example after none of its endpoints
+     *         accepted a connection.
+     */
+    void Invalidate(const std::string& host, const std::string& port);
+
+    /*! \brief Drop all entries.
+     */
+    void Clear();
+
+private:
+    struct Entry {
+        std::vector<boost::asio::ip::tcp::endpoint> endpoints {};
+        Clock::time_point expiry {};
+    };
+
+    std::mutex mutex_ {};
+    std::map<std::pair<std::string, std::string>, Entry> entries_ {};
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_DNS_CACHE_H
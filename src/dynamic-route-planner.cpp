@@ -0,0 +1,450 @@
+#include "dynamic-route-planner.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace NetworkMonitor {
+
+namespace {
+
+using QueueEntry = std::pair<std::uint32_t, std::uint32_t>; // distance, node
+using MinQueue = std::priority_queue<
+    QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>
+>;
+
+std::uint64_t MakeKey(StationIndex from, StationIndex to)
+{
+    return (static_cast<std::uint64_t>(from) << 32) | to;
+}
+
+bool SameItinerary(const Itinerary& a, const Itinerary& b)
+{
+    return a.cost == b.cost && a.travelTime == b.travelTime &&
+           a.changes == b.changes && a.edges == b.edges;
+}
+
+} // namespace
+
+DynamicRoutePlanner::DynamicRoutePlanner(
+    const NetworkLayout& layout,
+    RoutePlannerOptions options,
+    std::size_t maxSources
+) : layout_ {layout},
+    options_ {options},
+    maxSources_ {maxSources},
+    graph_ {RouteGraph::Build(layout, options.changePenalty)}
+{
+    const auto nArcs {graph_.arcs.size()};
+    arcSources_.resize(nArcs);
+    inArcs_.resize(nArcs);
+    edgeArcs_.assign(layout_.GetEdgeCount(), kInvalidIndex);
+    std::vector<std::uint32_t> cursor(graph_.reverseArcOffsets.begin(),
+                                      graph_.reverseArcOffsets.end() - 1);
+    for (std::uint32_t node {0}; node < graph_.nNodes; ++node) {
+        for (auto idx {graph_.arcOffsets[node]};
+             idx < graph_.arcOffsets[node + 1]; ++idx) {
+            const auto& arc {graph_.arcs[idx]};
+            arcSources_[idx] = node;
+            inArcs_[cursor[arc.to]++] = idx;
+            if (arc.edge != kInvalidIndex) {
+                edgeArcs_[arc.edge] = idx;
+            }
+        }
+    }
+    // Their weights would go stale.
+    graph_.reverseArcs = {};
+
+    firstChange_.assign(nArcs, kInvalidIndex);
+    affected_.assign(graph_.nNodes, 0);
+}
+
+std::uint32_t DynamicRoutePlanner::GetQuickestCost(
+    StationIndex from,
+    StationIndex to
+)
+{
+    return ToCost(from, to, GetTree(from).distances[to]);
+}
+
+bool DynamicRoutePlanner::GetQuickestRoute(
+    StationIndex from,
+    StationIndex to,
+    Itinerary& itinerary
+)
+{
+    return ExtractRoute(GetTree(from), from, to, itinerary);
+}
+
+void DynamicRoutePlanner::Watch(StationIndex from, StationIndex to)
+{
+    const auto key {MakeKey(from, to)};
+    if (watched_.count(key) > 0) {
+        return;
+    }
+    auto& tree {GetTree(from)};
+    tree.watched.push_back(to);
+    Itinerary itinerary {};
+    if (!ExtractRoute(tree, from, to, itinerary)) {
+        itinerary.cost = kUnreachable;
+    }
+    watched_.emplace(key, std::move(itinerary));
+}
+
+void DynamicRoutePlanner::Unwatch(StationIndex from, StationIndex to)
+{
+    if (watched_.erase(MakeKey(from, to)) == 0) {
+        return;
+    }
+    // The tree stays cached, and can be evicted once nothing watches it.
+    auto& watched {trees_.at(from).watched};
+    watched.erase(std::find(watched.begin(), watched.end(), to));
+}
+
+bool DynamicRoutePlanner::GetWatchedRoute(
+    StationIndex from,
+    StationIndex to,
+    Itinerary& itinerary
+) const
+{
+    const auto it {watched_.find(MakeKey(from, to))};
+    if (it == watched_.end() || it->second.cost == kUnreachable) {
+        return false;
+    }
+    itinerary = it->second;
+    return true;
+}
+
+void DynamicRoutePlanner::ApplyUpdates(
+    const std::vector<TravelTimeUpdate>& travelTimes,
+    const std::vector<StationDelayUpdate>& delays,
+    std::vector<RouteQuery>& changed
+)
+{
+    changed.clear();
+    lastRepairSize_ = 0;
+    lastRebuildCount_ = 0;
+
+    // Write the new weights, remembering the old weight of each arc the
+    // first time it changes.
+    changes_.clear();
+    for (const auto& update: travelTimes) {
+        if (update.edge < edgeArcs_.size() &&
+            edgeArcs_[update.edge] != kInvalidIndex) {
+            SetWeight(edgeArcs_[update.edge], update.travelTime);
+        }
+    }
+    const auto nStations {layout_.GetStationCount()};
+    for (const auto& update: delays) {
+        if (update.station >= nStations) {
+            continue;
+        }
+        // All the arcs leaving a station node board a route.
+        for (auto idx {graph_.arcOffsets[update.station]};
+             idx < graph_.arcOffsets[update.station + 1]; ++idx) {
+            SetWeight(idx, options_.changePenalty + update.delay);
+        }
+    }
+    for (const auto& change: changes_) {
+        firstChange_[change.arc] = kInvalidIndex;
+    }
+    changes_.erase(
+        std::remove_if(changes_.begin(), changes_.end(),
+            [this](const auto& change) {
+                return graph_.arcs[change.arc].weight == change.oldWeight;
+            }
+        ),
+        changes_.end()
+    );
+    if (changes_.empty()) {
+        return;
+    }
+
+    for (auto& entry: trees_) {
+        const auto from {entry.first};
+        auto& tree {entry.second};
+        if (!RepairTree(from, tree)) {
+            continue;
+        }
+        for (const auto to: tree.watched) {
+            Itinerary itinerary {};
+            if (!ExtractRoute(tree, from, to, itinerary)) {
+                itinerary.cost = kUnreachable;
+            }
+            auto& current {watched_.at(MakeKey(from, to))};
+            if (!SameItinerary(current, itinerary)) {
+                current = std::move(itinerary);
+                changed.push_back({from, to});
+            }
+        }
+    }
+}
+
+std::uint32_t DynamicRoutePlanner::GetQuickestCostDijkstra(
+    StationIndex from,
+    StationIndex to
+) const
+{
+    SourceTree tree {};
+    BuildTree(from, tree);
+    return ToCost(from, to, tree.distances[to]);
+}
+
+std::size_t DynamicRoutePlanner::GetCachedSourceCount() const
+{
+    return trees_.size();
+}
+
+std::size_t DynamicRoutePlanner::GetLastRepairSize() const
+{
+    return lastRepairSize_;
+}
+
+std::size_t DynamicRoutePlanner::GetLastRebuildCount() const
+{
+    return lastRebuildCount_;
+}
+
+DynamicRoutePlanner::SourceTree& DynamicRoutePlanner::GetTree(
+    StationIndex from
+)
+{
+    auto it {trees_.find(from)};
+    if (it != trees_.end()) {
+        it->second.lastUsed = ++clock_;
+        return it->second;
+    }
+
+    // Make room among the trees nothing watches.
+    while (true) {
+        std::size_t nUnwatched {0};
+        auto oldest {trees_.end()};
+        for (auto entry {trees_.begin()}; entry != trees_.end(); ++entry) {
+            if (!entry->second.watched.empty()) {
+                continue;
+            }
+            ++nUnwatched;
+            if (oldest == trees_.end() ||
+                entry->second.lastUsed < oldest->second.lastUsed) {
+                oldest = entry;
+            }
+        }
+        if (nUnwatched < maxSources_ || oldest == trees_.end()) {
+            break;
+        }
+        trees_.erase(oldest);
+    }
+
+    auto& tree {trees_[from]};
+    BuildTree(from, tree);
+    tree.lastUsed = ++clock_;
+    return tree;
+}
+
+void DynamicRoutePlanner::BuildTree(
+    StationIndex from,
+    SourceTree& tree
+) const
+{
+    auto& distances {tree.distances};
+    auto& parents {tree.parents};
+    distances.assign(graph_.nNodes, kUnreachable);
+    parents.assign(graph_.nNodes, kInvalidIndex);
+    MinQueue queue {};
+    distances[from] = 0;
+    queue.push({0, from});
+    while (!queue.empty()) {
+        const auto entry {queue.top()};
+        queue.pop();
+        const auto distance {entry.first};
+        const auto node {entry.second};
+        if (distance > distances[node]) {
+            continue;
+        }
+        for (auto idx {graph_.arcOffsets[node]};
+             idx < graph_.arcOffsets[node + 1]; ++idx) {
+            const auto& arc {graph_.arcs[idx]};
+            if (distance + arc.weight < distances[arc.to]) {
+                distances[arc.to] = distance + arc.weight;
+                parents[arc.to] = idx;
+                queue.push({distances[arc.to], arc.to});
+            }
+        }
+    }
+}
+
+bool DynamicRoutePlanner::RepairTree(StationIndex from, SourceTree& tree)
+{
+    // Past these sizes a repair does about the work of a Dijkstra search
+    // from scratch, and may have as much again ahead: rebuild the tree
+    // instead. Resetting a node also scans its incoming arcs, hence the
+    // smaller budget for the cut-off subtree. This bounds the cost of a
+    // tree to about two full searches.
+    const std::size_t maxSubtree {graph_.nNodes / 2};
+    const std::size_t maxRepaired {graph_.nNodes};
+    auto& distances {tree.distances};
+    auto& parents {tree.parents};
+    std::size_t nRepaired {0};
+    MinQueue queue {};
+    const auto relax = [&](std::uint32_t idx) {
+        const auto source {distances[arcSources_[idx]]};
+        const auto& arc {graph_.arcs[idx]};
+        if (source != kUnreachable && source + arc.weight < distances[arc.to]) {
+            distances[arc.to] = source + arc.weight;
+            parents[arc.to] = idx;
+            queue.push({distances[arc.to], arc.to});
+            ++nRepaired;
+        }
+    };
+
+    // A tree arc that got slower cuts off the subtree below it: every node
+    // in there may now be closer through some other arc.
+    affectedNodes_.clear();
+    for (const auto& change: changes_) {
+        const auto& arc {graph_.arcs[change.arc]};
+        if (arc.weight > change.oldWeight && parents[arc.to] == change.arc &&
+            !affected_[arc.to]) {
+            affected_[arc.to] = 1;
+            affectedNodes_.push_back(arc.to);
+        }
+    }
+    for (std::size_t idx {0};
+         idx < affectedNodes_.size() && affectedNodes_.size() <= maxSubtree;
+         ++idx) {
+        const auto node {affectedNodes_[idx]};
+        for (auto arc {graph_.arcOffsets[node]};
+             arc < graph_.arcOffsets[node + 1]; ++arc) {
+            const auto to {graph_.arcs[arc].to};
+            if (parents[to] == arc && !affected_[to]) {
+                affected_[to] = 1;
+                affectedNodes_.push_back(to);
+            }
+        }
+    }
+    if (affectedNodes_.size() > maxSubtree) {
+        // Nothing is reset yet: only the marks need undoing.
+        for (const auto node: affectedNodes_) {
+            affected_[node] = 0;
+        }
+        RebuildTree(from, tree);
+        return true;
+    }
+    for (const auto node: affectedNodes_) {
+        distances[node] = kUnreachable;
+        parents[node] = kInvalidIndex;
+    }
+    nRepaired += affectedNodes_.size();
+
+    // Reattach the subtree from outside, and relax the arcs that got faster.
+    for (const auto node: affectedNodes_) {
+        for (auto idx {graph_.reverseArcOffsets[node]};
+             idx < graph_.reverseArcOffsets[node + 1]; ++idx) {
+            relax(inArcs_[idx]);
+        }
+    }
+    for (const auto node: affectedNodes_) {
+        affected_[node] = 0;
+    }
+    for (const auto& change: changes_) {
+        if (graph_.arcs[change.arc].weight < change.oldWeight) {
+            relax(change.arc);
+        }
+    }
+
+    // Propagate from there. This only reaches nodes whose distance drops.
+    while (!queue.empty()) {
+        if (nRepaired > maxRepaired) {
+            RebuildTree(from, tree);
+            return true;
+        }
+        const auto entry {queue.top()};
+        queue.pop();
+        const auto node {entry.second};
+        if (entry.first > distances[node]) {
+            continue;
+        }
+        for (auto idx {graph_.arcOffsets[node]};
+             idx < graph_.arcOffsets[node + 1]; ++idx) {
+            relax(idx);
+        }
+    }
+    lastRepairSize_ += nRepaired;
+    return nRepaired > 0;
+}
+
+void DynamicRoutePlanner::RebuildTree(StationIndex from, SourceTree& tree)
+{
+    BuildTree(from, tree);
+    lastRepairSize_ += graph_.nNodes;
+    ++lastRebuildCount_;
+}
+
+void DynamicRoutePlanner::SetWeight(std::uint32_t arc, std::uint32_t weight)
+{
+    if (firstChange_[arc] == kInvalidIndex) {
+        firstChange_[arc] = static_cast<std::uint32_t>(changes_.size());
+        changes_.push_back({arc, graph_.arcs[arc].weight});
+    }
+    graph_.arcs[arc].weight = weight;
+}
+
+bool DynamicRoutePlanner::ExtractRoute(
+    const SourceTree& tree,
+    StationIndex from,
+    StationIndex to,
+    Itinerary& itinerary
+) const
+{
+    const auto total {tree.distances[to]};
+    if (total == kUnreachable) {
+        return false;
+    }
+
+    // Walk the tree up from the target.
+    std::vector<std::uint32_t> path {};
+    std::uint32_t node {to};
+    while (node != from) {
+        const auto arc {tree.parents[node]};
+        if (arc == kInvalidIndex || path.size() == graph_.nNodes) {
+            return false;
+        }
+        path.push_back(arc);
+        node = arcSources_[arc];
+    }
+
+    Itinerary result {};
+    result.cost = ToCost(from, to, total);
+    std::uint32_t boardings {0};
+    for (auto it {path.rbegin()}; it != path.rend(); ++it) {
+        const auto& arc {graph_.arcs[*it]};
+        if (arc.edge != kInvalidIndex) {
+            result.edges.push_back(arc.edge);
+            result.travelTime += arc.weight;
+        } else if (arcSources_[*it] < layout_.GetStationCount()) {
+            ++boardings;
+        }
+    }
+    result.changes = boardings > 0 ? boardings - 1 : 0;
+    itinerary = std::move(result);
+    return true;
+}
+
+std::uint32_t DynamicRoutePlanner::ToCost(
+    StationIndex from,
+    StationIndex to,
+    std::uint32_t distance
+) const
+{
+    // As in RoutePlanner: the first boarding is not a change. Its station
+    // delay, if any, is part of the cost.
+    if (from == to) {
+        return 0;
+    }
+    if (distance == kUnreachable) {
+        return kUnreachable;
+    }
+    return distance - options_.changePenalty;
+}
+
+} // namespace NetworkMonitor
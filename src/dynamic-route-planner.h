@@ -0,0 +1,202 @@
+#ifndef NETWORK_MONITOR_DYNAMIC_ROUTE_PLANNER_H
+#define NETWORK_MONITOR_DYNAMIC_ROUTE_PLANNER_H
+
+#include "network-layout.h"
+#include "route-graph.h"
+#include "route-planner.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief A new travel time for one layout edge, for example after a delay
+ *         on that segment.
+ */
+struct TravelTimeUpdate {
+    EdgeIndex edge;
+    std::uint32_t travelTime;
+};
+
+/*! \brief A new extra cost to board any route at a station, for example
+ *         because the station is crowded. It is 0 until set.
+ */
+struct StationDelayUpdate {
+    StationIndex station;
+    std::uint32_t delay;
+};
+
+/*! \brief Answers quickest-path queries while travel times change.
+ *
+ *  The planner searches the same RouteGraph as RoutePlanner, but keeps a
+ *  shortest-path tree for each source station it has been queried from.
+ *  A query from a cached source is a lookup in its tree.
+ *
+ *  When weights change, each tree is repaired rather than recomputed:
+ *  - a tree arc that got slower invalidates the subtree below it, which is
+ *    reattached from its cheapest neighbours outside the subtree;
+ *  - an arc that got faster is relaxed;
+ *  and a Dijkstra search from those nodes only visits the nodes whose
+ *  distance actually changes. Most updates touch a handful of nodes. A
+ *  repair that cuts off half the tree, or touches more labels than the
+ *  tree has nodes, for example below a busy interchange, is abandoned and
+ *  the tree is rebuilt from scratch: an update never costs much more than
+ *  a recomputation.
+ *
+ *  Itineraries can be watched: their source trees are never evicted, and
+ *  ApplyUpdates() reports which ones changed.
+ *
+ *  \note This class is not thread safe. Feed it updates and queries from
+ *        one thread.
+ */
+class DynamicRoutePlanner {
+public:
+    /*! \brief Build the planner. No tree is computed yet.
+     *
+     *  \param layout     The network, with its initial travel times. It must
+     *                    outlive the planner.
+     *  \param options    Tuning knobs, as for RoutePlanner.
+     *  \param maxSources Number of trees kept for sources that have no
+     *                    watched itinerary. The least recently queried one is
+     *                    dropped first.
+     */
+    explicit DynamicRoutePlanner(
+        const NetworkLayout& layout,
+        RoutePlannerOptions options = {},
+        std::size_t maxSources = 64
+    );
+
+    /*! \brief Cost of the quickest path, penalties and delays included.
+     *
+     *  Computes the tree of the source if it is not cached.
+     *
+     *  \returns kUnreachable if there is no path.
+     */
+    std::uint32_t GetQuickestCost(StationIndex from, StationIndex to);
+
+    /*! \brief Compute the quickest path.
+     *
+     *  \returns false if there is no path. The itinerary is left untouched.
+     */
+    bool GetQuickestRoute(
+        StationIndex from,
+        StationIndex to,
+        Itinerary& itinerary
+    );
+
+    /*! \brief Keep an itinerary up to date and report its changes from
+     *         ApplyUpdates().
+     */
+    void Watch(StationIndex from, StationIndex to);
+
+    void Unwatch(StationIndex from, StationIndex to);
+
+    /*! \brief Current version of a watched itinerary.
+     *
+     *  \returns false if the pair is not watched or has no path.
+     */
+    bool GetWatchedRoute(
+        StationIndex from,
+        StationIndex to,
+        Itinerary& itinerary
+    ) const;
+
+    /*! \brief Apply a batch of weight changes and repair the cached trees.
+     *
+     *  Updates for unknown edges or stations are ignored. When an edge or a
+     *  station appears several times, the last update wins.
+     *
+     *  \param changed Filled with the watched itineraries whose edges, travel
+     *                 time or cost changed.
+     */
+    void ApplyUpdates(
+        const std::vector<TravelTimeUpdate>& travelTimes,
+        const std::vector<StationDelayUpdate>& delays,
+        std::vector<RouteQuery>& changed
+    );
+
+    /*! \brief Cost of the quickest path with the current weights, computed
+     *         with a plain Dijkstra search and no cache. Slow; meant for
+     *         validation and comparison.
+     */
+    std::uint32_t GetQuickestCostDijkstra(
+        StationIndex from,
+        StationIndex to
+    ) const;
+
+    /*! \brief Number of source trees held.
+     */
+    std::size_t GetCachedSourceCount() const;
+
+    /*! \brief Node labels reset or improved by the last ApplyUpdates(),
+     *         over all the trees: a measure of the repair work. A rebuilt
+     *         tree counts all its nodes.
+     */
+    std::size_t GetLastRepairSize() const;
+
+    /*! \brief Trees that the last ApplyUpdates() rebuilt from scratch
+     *         because their repair grew too large.
+     */
+    std::size_t GetLastRebuildCount() const;
+
+private:
+    struct SourceTree {
+        // Per node: distance from the source, and the arc it is reached
+        // through (kInvalidIndex for the source and unreachable nodes).
+        std::vector<std::uint32_t> distances {};
+        std::vector<std::uint32_t> parents {};
+        std::vector<StationIndex> watched {};
+        std::uint64_t lastUsed {0};
+    };
+
+    struct ArcChange {
+        std::uint32_t arc;
+        std::uint32_t oldWeight;
+    };
+
+    const NetworkLayout& layout_;
+    RoutePlannerOptions options_;
+    std::size_t maxSources_;
+
+    // Only the forward arcs of the graph are kept up to date. Incoming arcs
+    // are found through inArcs_, which holds forward arc indices.
+    RouteGraph graph_;
+    std::vector<std::uint32_t> arcSources_ {};
+    std::vector<std::uint32_t> inArcs_ {};
+    std::vector<std::uint32_t> edgeArcs_ {};
+
+    std::unordered_map<StationIndex, SourceTree> trees_ {};
+    std::unordered_map<std::uint64_t, Itinerary> watched_ {};
+    std::uint64_t clock_ {0};
+    std::size_t lastRepairSize_ {0};
+    std::size_t lastRebuildCount_ {0};
+
+    // Scratch space for the repairs, sized to the graph.
+    std::vector<std::uint32_t> firstChange_ {};
+    std::vector<ArcChange> changes_ {};
+    std::vector<std::uint8_t> affected_ {};
+    std::vector<std::uint32_t> affectedNodes_ {};
+
+    SourceTree& GetTree(StationIndex from);
+    void BuildTree(StationIndex from, SourceTree& tree) const;
+    bool RepairTree(StationIndex from, SourceTree& tree);
+    void RebuildTree(StationIndex from, SourceTree& tree);
+    void SetWeight(std::uint32_t arc, std::uint32_t weight);
+    bool ExtractRoute(
+        const SourceTree& tree,
+        StationIndex from,
+        StationIndex to,
+        Itinerary& itinerary
+    ) const;
+    std::uint32_t ToCost(
+        StationIndex from,
+        StationIndex to,
+        std::uint32_t distance
+    ) const;
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_DYNAMIC_ROUTE_PLANNER_H
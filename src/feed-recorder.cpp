@@ -0,0 +1,509 @@
+#include "feed-recorder.h"
+
+#include <boost/beast/zlib/error.hpp>
+#include <boost/beast/zlib/inflate_stream.hpp>
+
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace NetworkMonitor {
+
+namespace {
+
+/* Recording file layout, in the byte order of the machine that wrote it:
+
+   FeedHeader
+   SegmentHeader, then storedBytes of segment data
+   SegmentHeader, then storedBytes of segment data
+   ...
+
+   The segment data, once inflated if kCompressed is set, is nFrames
+   records of:
+   - the arrival time, in nanoseconds after the previous frame of the
+     segment (the first frame arrives at baseTime), as a varint;
+   - the frame size, as a varint;
+   - the frame.
+
+   Times are relative to the start of the recording, whose wall clock time
+   is in the file header.
+
+   Bump kFeedVersion whenever any of this changes. */
+constexpr char kFeedMagic[8] {'N', 'M', 'F', 'E', 'E', 'D', 0, 0};
+constexpr std::uint32_t kFeedVersion {1};
+constexpr std::uint32_t kByteOrderMark {0x01020304};
+constexpr std::uint32_t kCompressed {1};
+
+// Spare segments kept by the writer, so that the steady state allocates
+// nothing.
+constexpr std::size_t kMaxSpareSegments {4};
+
+struct FeedHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::int64_t startTime; // Nanoseconds since the system clock epoch.
+};
+
+struct SegmentHeader {
+    std::uint32_t flags;
+    std::uint32_t nFrames;
+    std::uint32_t rawBytes;
+    std::uint32_t storedBytes;
+    std::int64_t baseTime; // Nanoseconds since the start of the recording.
+};
+
+static_assert(std::is_trivially_copyable<FeedHeader>::value &&
+              sizeof(FeedHeader) == 24,
+              "FeedHeader is stored as is in recordings");
+static_assert(std::is_trivially_copyable<SegmentHeader>::value &&
+              sizeof(SegmentHeader) == 24,
+              "SegmentHeader is stored as is in recordings");
+
+boost::system::error_code MakeError(boost::system::errc::errc_t error)
+{
+    return boost::system::errc::make_error_code(error);
+}
+
+void PutVarint(std::vector<char>& out, std::uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool GetVarint(const char*& pos, const char* end, std::uint64_t& value)
+{
+    value = 0;
+    for (unsigned shift {0}; pos != end && shift < 64; shift += 7) {
+        const auto byte {static_cast<unsigned char>(*pos++)};
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+// FeedRecorder
+
+FeedRecorder::FeedRecorder(FeedRecorderOptions options)
+    : options_ {options}
+{
+}
+
+FeedRecorder::~FeedRecorder()
+{
+    boost::system::error_code ignored {};
+    Close(ignored);
+}
+
+void FeedRecorder::Open(const std::string& path, boost::system::error_code& ec)
+{
+    std::lock_guard<std::mutex> lock {mutex_};
+    if (open_) {
+        ec = MakeError(boost::system::errc::operation_in_progress);
+        return;
+    }
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    FeedHeader header {};
+    std::memcpy(header.magic, kFeedMagic, sizeof(header.magic));
+    header.version = kFeedVersion;
+    header.byteOrder = kByteOrderMark;
+    header.startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!file_) {
+        file_.close();
+        file_.clear();
+        ec = MakeError(boost::system::errc::io_error);
+        return;
+    }
+    start_ = std::chrono::steady_clock::now();
+    current_ = {};
+    current_.data.reserve(options_.segmentBytes);
+    full_.clear();
+    pendingBytes_ = 0;
+    error_ = {};
+    stats_ = {};
+    stats_.fileBytes = sizeof(header);
+    open_ = true;
+    closing_ = false;
+    writer_ = std::thread {[this]() { RunWriter(); }};
+    ec = {};
+}
+
+void FeedRecorder::Record(boost::beast::string_view frame)
+{
+    std::lock_guard<std::mutex> lock {mutex_};
+    if (!open_) {
+        return;
+    }
+    if (closing_ || error_ ||
+        pendingBytes_ + frame.size() > options_.maxPendingBytes) {
+        ++stats_.framesDropped;
+        return;
+    }
+
+    const std::int64_t now {
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_
+        ).count()
+    };
+    auto& data {current_.data};
+    const auto sizeBefore {data.size()};
+    if (current_.nFrames == 0) {
+        current_.baseTime = now;
+        current_.lastTime = now;
+    }
+    PutVarint(data, static_cast<std::uint64_t>(now - current_.lastTime));
+    PutVarint(data, frame.size());
+    data.insert(data.end(), frame.data(), frame.data() + frame.size());
+    current_.lastTime = now;
+    ++current_.nFrames;
+    pendingBytes_ += data.size() - sizeBefore;
+    ++stats_.framesRecorded;
+    stats_.frameBytes += frame.size();
+    if (data.size() >= options_.segmentBytes) {
+        Seal();
+        wakeWriter_.notify_one();
+    }
+}
+
+std::function<void (boost::system::error_code, std::string&&)>
+FeedRecorder::Wrap(
+    std::function<void (boost::system::error_code, std::string&&)> onMessage
+)
+{
+    return [this, onMessage = std::move(onMessage)](auto ec, auto&& message) {
+        if (!ec) {
+            Record(message);
+        }
+        if (onMessage) {
+            onMessage(ec, std::move(message));
+        }
+    };
+}
+
+std::function<void (boost::system::error_code, boost::beast::string_view)>
+FeedRecorder::WrapView(
+    std::function<void (boost::system::error_code,
+                        boost::beast::string_view)> onMessage
+)
+{
+    return [this, onMessage = std::move(onMessage)](auto ec, auto message) {
+        if (!ec) {
+            Record(message);
+        }
+        if (onMessage) {
+            onMessage(ec, message);
+        }
+    };
+}
+
+void FeedRecorder::Close(boost::system::error_code& ec)
+{
+    {
+        std::lock_guard<std::mutex> lock {mutex_};
+        if (!open_ || closing_) {
+            ec = {};
+            return;
+        }
+        closing_ = true;
+    }
+    wakeWriter_.notify_one();
+    writer_.join();
+
+    std::lock_guard<std::mutex> lock {mutex_};
+    file_.close();
+    if (!file_ && !error_) {
+        error_ = MakeError(boost::system::errc::io_error);
+    }
+    file_.clear();
+    open_ = false;
+    ec = error_;
+}
+
+FeedRecorderStats FeedRecorder::GetStats() const
+{
+    std::lock_guard<std::mutex> lock {mutex_};
+    return stats_;
+}
+
+void FeedRecorder::Seal()
+{
+    full_.push_back(std::move(current_));
+    if (spare_.empty()) {
+        current_ = {};
+        current_.data.reserve(options_.segmentBytes);
+    } else {
+        current_ = std::move(spare_.back());
+        spare_.pop_back();
+    }
+}
+
+void FeedRecorder::RunWriter()
+{
+    std::vector<Segment> batch {};
+    std::vector<char> buffer {};
+    bool failed {false};
+    std::unique_lock<std::mutex> lock {mutex_};
+    while (true) {
+        const bool woken {wakeWriter_.wait_for(lock, options_.flushInterval,
+            [this]() { return !full_.empty() || closing_; }
+        )};
+        // Write what there is when the flush interval is up, or when
+        // closing.
+        if (current_.nFrames > 0 && (!woken || closing_)) {
+            Seal();
+        }
+        if (full_.empty()) {
+            if (closing_) {
+                break;
+            }
+            continue;
+        }
+
+        batch.swap(full_);
+        lock.unlock();
+        std::uint64_t nBytes {0};
+        if (!failed) {
+            for (const auto& segment: batch) {
+                const auto written {Write(segment, buffer)};
+                if (written == 0) {
+                    failed = true;
+                    break;
+                }
+                nBytes += written;
+            }
+            failed = failed || !file_.flush();
+        }
+        lock.lock();
+
+        if (failed) {
+            error_ = MakeError(boost::system::errc::io_error);
+        } else {
+            stats_.fileBytes += nBytes;
+            stats_.segments += batch.size();
+        }
+        for (auto& segment: batch) {
+            pendingBytes_ -= segment.data.size();
+            if (spare_.size() < kMaxSpareSegments) {
+                segment.data.clear();
+                segment.nFrames = 0;
+                spare_.push_back(std::move(segment));
+            }
+        }
+        batch.clear();
+    }
+}
+
+std::size_t FeedRecorder::Write(
+    const Segment& segment,
+    std::vector<char>& buffer
+)
+{
+    // Returns the bytes written, or 0 on failure. buffer holds the deflated
+    // segment, and is kept between calls.
+    SegmentHeader header {};
+    header.nFrames = segment.nFrames;
+    header.rawBytes = static_cast<std::uint32_t>(segment.data.size());
+    header.storedBytes = header.rawBytes;
+    header.baseTime = segment.baseTime;
+    const char* stored {segment.data.data()};
+    if (options_.compress) {
+        namespace zlib = boost::beast::zlib;
+        deflate_.reset(options_.compressionLevel, 15, 8,
+                       zlib::Strategy::normal);
+        buffer.resize(deflate_.upper_bound(segment.data.size()));
+        zlib::z_params params {};
+        params.next_in = segment.data.data();
+        params.avail_in = segment.data.size();
+        params.next_out = buffer.data();
+        params.avail_out = buffer.size();
+        boost::system::error_code ec {};
+        // With upper_bound() bytes of room this finishes in one call.
+        deflate_.write(params, zlib::Flush::finish, ec);
+        if (ec != zlib::error::end_of_stream) {
+            return 0;
+        }
+        header.flags = kCompressed;
+        header.storedBytes = static_cast<std::uint32_t>(params.total_out);
+        stored = buffer.data();
+    }
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file_.write(stored, header.storedBytes);
+    return file_ ? sizeof(header) + header.storedBytes : 0;
+}
+
+// FeedReplayer
+
+FeedReplayer::FeedReplayer(FeedReplayerOptions options)
+    : options_ {options}
+{
+}
+
+void FeedReplayer::Open(const std::string& path, boost::system::error_code& ec)
+{
+    std::ifstream file {path, std::ios::binary};
+    if (!file) {
+        ec = MakeError(boost::system::errc::no_such_file_or_directory);
+        return;
+    }
+    FeedHeader header {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (file.gcount() != sizeof(header) ||
+        std::memcmp(header.magic, kFeedMagic, sizeof(header.magic)) != 0) {
+        ec = MakeError(boost::system::errc::invalid_argument);
+        return;
+    }
+    if (header.version != kFeedVersion || header.byteOrder != kByteOrderMark) {
+        ec = MakeError(boost::system::errc::not_supported);
+        return;
+    }
+    path_ = path;
+    startTime_ = std::chrono::system_clock::time_point {
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds {header.startTime}
+        )
+    };
+    ec = {};
+}
+
+std::size_t FeedReplayer::Replay(
+    const std::function<void (boost::system::error_code,
+                              std::string&&)>& onMessage,
+    boost::system::error_code& ec
+)
+{
+    return ReplayFrames([&onMessage](boost::beast::string_view frame) {
+        onMessage({}, std::string {frame.data(), frame.size()});
+    }, ec);
+}
+
+std::size_t FeedReplayer::ReplayView(
+    const std::function<void (boost::system::error_code,
+                              boost::beast::string_view)>& onMessage,
+    boost::system::error_code& ec
+)
+{
+    return ReplayFrames([&onMessage](boost::beast::string_view frame) {
+        onMessage({}, frame);
+    }, ec);
+}
+
+std::chrono::system_clock::time_point FeedReplayer::GetStartTime() const
+{
+    return startTime_;
+}
+
+template <typename Deliver>
+std::size_t FeedReplayer::ReplayFrames(
+    Deliver&& deliver,
+    boost::system::error_code& ec
+)
+{
+    namespace zlib = boost::beast::zlib;
+    using Clock = std::chrono::steady_clock;
+
+    ec = {};
+    std::ifstream file {path_, std::ios::binary};
+    if (path_.empty() || !file) {
+        ec = MakeError(boost::system::errc::no_such_file_or_directory);
+        return 0;
+    }
+    file.seekg(sizeof(FeedHeader));
+
+    std::vector<char> stored {};
+    std::vector<char> raw {};
+    zlib::inflate_stream inflate {};
+    std::size_t nFrames {0};
+    bool started {false};
+    Clock::time_point replayStart {};
+    std::int64_t firstTime {0};
+    const auto invalid {MakeError(boost::system::errc::invalid_argument)};
+    while (true) {
+        SegmentHeader header {};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (file.gcount() == 0 && file.eof()) {
+            break;
+        }
+        if (file.gcount() != sizeof(header) ||
+            (header.flags & ~kCompressed) != 0 ||
+            (header.flags == 0 && header.storedBytes != header.rawBytes)) {
+            ec = invalid;
+            break;
+        }
+        stored.resize(header.storedBytes);
+        file.read(stored.data(), header.storedBytes);
+        if (file.gcount() != header.storedBytes) {
+            ec = invalid;
+            break;
+        }
+
+        const char* pos {stored.data()};
+        if (header.flags & kCompressed) {
+            raw.resize(header.rawBytes);
+            inflate.reset(15);
+            zlib::z_params params {};
+            params.next_in = stored.data();
+            params.avail_in = stored.size();
+            params.next_out = raw.data();
+            params.avail_out = raw.size();
+            boost::system::error_code inflateEc {};
+            while (!inflateEc) {
+                inflate.write(params, zlib::Flush::finish, inflateEc);
+            }
+            if (inflateEc != zlib::error::end_of_stream ||
+                params.total_out != header.rawBytes) {
+                ec = invalid;
+                break;
+            }
+            pos = raw.data();
+        }
+
+        const auto end {pos + header.rawBytes};
+        auto time {header.baseTime};
+        for (std::uint32_t idx {0}; idx < header.nFrames; ++idx) {
+            std::uint64_t delta {0};
+            std::uint64_t size {0};
+            if (!GetVarint(pos, end, delta) || !GetVarint(pos, end, size) ||
+                size > static_cast<std::uint64_t>(end - pos)) {
+                ec = invalid;
+                return nFrames;
+            }
+            time += static_cast<std::int64_t>(delta);
+            if (options_.originalPacing) {
+                if (!started) {
+                    replayStart = Clock::now();
+                    firstTime = time;
+                    started = true;
+                }
+                std::this_thread::sleep_until(replayStart +
+                    std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double, std::nano> {
+                            (time - firstTime) / options_.speed
+                        }
+                    )
+                );
+            }
+            deliver(boost::beast::string_view {
+                pos, static_cast<std::size_t>(size)
+            });
+            pos += size;
+            ++nFrames;
+        }
+        if (pos != end) {
+            ec = invalid;
+            break;
+        }
+    }
+    return nFrames;
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,220 @@
+#ifndef NETWORK_MONITOR_FEED_RECORDER_H
+#define NETWORK_MONITOR_FEED_RECORDER_H
+
+#include <boost/beast/core/string.hpp>
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief Tuning knobs for FeedRecorder.
+ */
+struct FeedRecorderOptions {
+    /*! \brief Deflate each segment. Feed frames shrink 5 to 10 times, at the
+     *         cost of CPU time on the writer thread.
+     */
+    bool compress {false};
+
+    /*! \brief Deflate level, from 1 (fastest) to 9 (smallest).
+     */
+    int compressionLevel {6};
+
+    /*! \brief A segment is written once it holds this many bytes of frames.
+     */
+    std::size_t segmentBytes {256 * 1024};
+
+    /*! \brief A segment that is not full is written after this long, so that
+     *         a recording is never more than this far behind the feed.
+     */
+    std::chrono::milliseconds flushInterval {200};
+
+    /*! \brief Frames waiting for the writer thread, in bytes. Beyond this
+     *         the recorder drops frames rather than block the caller.
+     */
+    std::size_t maxPendingBytes {64 * 1024 * 1024};
+};
+
+/*! \brief Counters of a FeedRecorder.
+ */
+struct FeedRecorderStats {
+    std::uint64_t framesRecorded {0};
+    std::uint64_t framesDropped {0};
+    std::uint64_t frameBytes {0};
+    std::uint64_t fileBytes {0};
+    std::uint64_t segments {0};
+};
+
+/*! \brief Records the frames a WebSocketClient delivers to a file, for
+ *         FeedReplayer to play back.
+ *
+ *  A recording is a file header followed by segments. Each segment holds
+ *  a batch of frames, each with its length and its arrival time, and is
+ *  optionally deflated as a whole.
+ *
+ *  Record() only copies the frame into the current segment under a mutex;
+ *  a background thread compresses and writes full segments, one write per
+ *  segment. The thread calling Record(), typically the client strand,
+ *  never waits for the disk.
+ *
+ *  \note This class is thread safe.
+ */
+class FeedRecorder {
+public:
+    explicit FeedRecorder(FeedRecorderOptions options = {});
+
+    /*! \brief Close the recording, if still open.
+     */
+    ~FeedRecorder();
+
+    FeedRecorder(const FeedRecorder&) = delete;
+    FeedRecorder& operator=(const FeedRecorder&) = delete;
+
+    /*! \brief Create the recording file, replacing any existing one, and
+     *         start the writer thread.
+     */
+    void Open(const std::string& path, boost::system::error_code& ec);
+
+    /*! \brief Append a frame, timestamped now.
+     *
+     *  Frames are dropped if the recording is not open, if the writer
+     *  thread is too far behind or after a write error.
+     */
+    void Record(boost::beast::string_view frame);
+
+    /*! \brief Wrap a message handler so that it records every message
+     *         before handling it. Pass the result to
+     *         WebSocketClient::Connect().
+     */
+    std::function<void (boost::system::error_code, std::string&&)> Wrap(
+        std::function<void (boost::system::error_code, std::string&&)>
+            onMessage = nullptr
+    );
+
+    /*! \brief As Wrap(), for WebSocketClient::ConnectView().
+     */
+    std::function<void (boost::system::error_code,
+                        boost::beast::string_view)> WrapView(
+        std::function<void (boost::system::error_code,
+                            boost::beast::string_view)> onMessage = nullptr
+    );
+
+    /*! \brief Write the frames recorded so far, stop the writer thread and
+     *         close the file.
+     *
+     *  \param ec The first write error, if any.
+     */
+    void Close(boost::system::error_code& ec);
+
+    FeedRecorderStats GetStats() const;
+
+private:
+    struct Segment {
+        std::vector<char> data {};
+        std::uint32_t nFrames {0};
+        std::int64_t baseTime {0};
+        std::int64_t lastTime {0};
+    };
+
+    FeedRecorderOptions options_;
+    std::ofstream file_ {};
+    std::thread writer_ {};
+    std::chrono::steady_clock::time_point start_ {};
+
+    // Only used by the writer thread.
+    boost::beast::zlib::deflate_stream deflate_ {};
+
+    // Guarded by mutex_.
+    mutable std::mutex mutex_ {};
+    std::condition_variable wakeWriter_ {};
+    bool open_ {false};
+    bool closing_ {false};
+    Segment current_ {};
+    std::vector<Segment> full_ {};
+    std::vector<Segment> spare_ {};
+    std::size_t pendingBytes_ {0};
+    boost::system::error_code error_ {};
+    FeedRecorderStats stats_ {};
+
+    void Seal();
+    void RunWriter();
+    std::size_t Write(const Segment& segment, std::vector<char>& buffer);
+};
+
+/*! \brief Tuning knobs for FeedReplayer.
+ */
+struct FeedReplayerOptions {
+    /*! \brief Deliver the frames with the gaps they were recorded with,
+     *         rather than as fast as possible.
+     */
+    bool originalPacing {false};
+
+    /*! \brief With originalPacing, play back this many times faster than
+     *         real time.
+     */
+    double speed {1.0};
+};
+
+/*! \brief Plays back a recording made by FeedRecorder through the same
+ *         callbacks WebSocketClient uses, with no network.
+ *
+ *  Replay is synchronous: the callback runs on the calling thread, one
+ *  frame at a time. The file is read one segment at a time.
+ */
+class FeedReplayer {
+public:
+    explicit FeedReplayer(FeedReplayerOptions options = {});
+
+    /*! \brief Check the header of a recording. It can then be replayed any
+     *         number of times.
+     */
+    void Open(const std::string& path, boost::system::error_code& ec);
+
+    /*! \brief Deliver every frame of the recording, in order.
+     *
+     *  \param ec Set if the file is damaged or truncated, as it is when the
+     *            recorder did not get to close it. The frames before the
+     *            damage are delivered.
+     *
+     *  \returns The number of frames delivered.
+     */
+    std::size_t Replay(
+        const std::function<void (boost::system::error_code,
+                                  std::string&&)>& onMessage,
+        boost::system::error_code& ec
+    );
+
+    /*! \brief As Replay(), without copying each frame into a std::string.
+     */
+    std::size_t ReplayView(
+        const std::function<void (boost::system::error_code,
+                                  boost::beast::string_view)>& onMessage,
+        boost::system::error_code& ec
+    );
+
+    /*! \brief Wall clock time at which the recording started.
+     */
+    std::chrono::system_clock::time_point GetStartTime() const;
+
+private:
+    FeedReplayerOptions options_;
+    std::string path_ {};
+    std::chrono::system_clock::time_point startTime_ {};
+
+    template <typename Deliver>
+    std::size_t ReplayFrames(Deliver&& deliver, boost::system::error_code& ec);
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_FEED_RECORDER_H
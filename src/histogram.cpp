@@ -0,0 +1,207 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace NetworkMonitor {
+
+constexpr unsigned Histogram::kSubBucketBits;
+constexpr unsigned AtomicHistogram::kDefaultSubBucketBits;
+
+namespace {
+
+// Position of the highest set bit. value must not be 0.
+unsigned GetMagnitude(std::uint64_t value)
+{
+#if defined(__GNUC__)
+    return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#else
+    unsigned magnitude {0};
+    while (value >>= 1) {
+        ++magnitude;
+    }
+    return magnitude;
+#endif
+}
+
+std::size_t GetBucketCount(unsigned subBucketBits)
+{
+    return (64 - subBucketBits + 1) * (std::size_t {1} << subBucketBits);
+}
+
+std::size_t GetIndex(std::uint64_t value, unsigned subBucketBits)
+{
+    const std::size_t subBuckets {std::size_t {1} << subBucketBits};
+    if (value < 2 * subBuckets) {
+        return static_cast<std::size_t>(value);
+    }
+    const auto shift {GetMagnitude(value) - subBucketBits};
+    return shift * subBuckets + static_cast<std::size_t>(value >> shift);
+}
+
+std::uint64_t GetUpperBound(std::size_t index, unsigned subBucketBits)
+{
+    const std::size_t subBuckets {std::size_t {1} << subBucketBits};
+    if (index < 2 * subBuckets) {
+        return index;
+    }
+    const auto shift {index / subBuckets - 1};
+    const std::uint64_t lower {
+        static_cast<std::uint64_t>(index % subBuckets + subBuckets) << shift
+    };
+    return lower + ((std::uint64_t {1} << shift) - 1);
+}
+
+} // namespace
+
+// Histogram
+
+Histogram::Histogram()
+    : Histogram {kSubBucketBits}
+{
+}
+
+Histogram::Histogram(unsigned subBucketBits)
+    : subBucketBits_ {subBucketBits},
+      counts_(GetBucketCount(subBucketBits), 0)
+{
+}
+
+void Histogram::Record(std::uint64_t value)
+{
+    ++counts_[GetIndex(value, subBucketBits_)];
+    if (count_ == 0 || value < min_) {
+        min_ = value;
+    }
+    max_ = std::max(max_, value);
+    ++count_;
+    sum_ += static_cast<double>(value);
+}
+
+void Histogram::Merge(const Histogram& other)
+{
+    if (other.count_ == 0 || other.subBucketBits_ != subBucketBits_) {
+        return;
+    }
+    for (std::size_t idx {0}; idx < counts_.size(); ++idx) {
+        counts_[idx] += other.counts_[idx];
+    }
+    min_ = count_ == 0 ? other.min_ : std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    count_ += other.count_;
+    sum_ += other.sum_;
+}
+
+void Histogram::Reset()
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    count_ = 0;
+    min_ = 0;
+    max_ = 0;
+    sum_ = 0;
+}
+
+std::uint64_t Histogram::GetCount() const
+{
+    return count_;
+}
+
+std::uint64_t Histogram::GetMin() const
+{
+    return min_;
+}
+
+std::uint64_t Histogram::GetMax() const
+{
+    return max_;
+}
+
+double Histogram::GetMean() const
+{
+    return count_ == 0 ? 0.0 : sum_ / static_cast<double>(count_);
+}
+
+std::uint64_t Histogram::GetValueAtPercentile(double percentile) const
+{
+    if (count_ == 0) {
+        return 0;
+    }
+    const auto clamped {std::min(std::max(percentile, 0.0), 100.0)};
+    const auto rank {std::max<std::uint64_t>(1, static_cast<std::uint64_t>(
+        std::ceil(clamped / 100.0 * static_cast<double>(count_))
+    ))};
+    std::uint64_t seen {0};
+    for (std::size_t idx {0}; idx < counts_.size(); ++idx) {
+        seen += counts_[idx];
+        if (seen >= rank) {
+            return std::min(GetUpperBound(idx, subBucketBits_), max_);
+        }
+    }
+    return max_;
+}
+
+std::uint64_t Histogram::GetCountAtOrBelow(std::uint64_t value) const
+{
+    const auto last {GetIndex(value, subBucketBits_)};
+    std::uint64_t count {0};
+    for (std::size_t idx {0}; idx <= last; ++idx) {
+        count += counts_[idx];
+    }
+    return count;
+}
+
+double Histogram::GetSum() const
+{
+    return sum_;
+}
+
+// AtomicHistogram
+
+AtomicHistogram::AtomicHistogram(unsigned subBucketBits)
+    : subBucketBits_ {subBucketBits},
+      nBuckets_ {GetBucketCount(subBucketBits)},
+      counts_ {new std::atomic<std::uint64_t>[nBuckets_]}
+{
+    for (std::size_t idx {0}; idx < nBuckets_; ++idx) {
+        counts_[idx].store(0, std::memory_order_relaxed);
+    }
+}
+
+void AtomicHistogram::Record(std::uint64_t value)
+{
+    // One writer: load and store instead of a locked fetch_add.
+    const auto add = [](std::atomic<std::uint64_t>& counter,
+                        std::uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n,
+                      std::memory_order_relaxed);
+    };
+    add(counts_[GetIndex(value, subBucketBits_)], 1);
+    const auto count {count_.load(std::memory_order_relaxed)};
+    if (count == 0 || value < min_.load(std::memory_order_relaxed)) {
+        min_.store(value, std::memory_order_relaxed);
+    }
+    if (value > max_.load(std::memory_order_relaxed)) {
+        max_.store(value, std::memory_order_relaxed);
+    }
+    count_.store(count + 1, std::memory_order_relaxed);
+    add(sum_, value);
+}
+
+Histogram AtomicHistogram::Snapshot() const
+{
+    Histogram snapshot {subBucketBits_};
+    for (std::size_t idx {0}; idx < nBuckets_; ++idx) {
+        snapshot.counts_[idx] = counts_[idx].load(std::memory_order_relaxed);
+        snapshot.count_ += snapshot.counts_[idx];
+    }
+    if (snapshot.count_ > 0) {
+        snapshot.min_ = min_.load(std::memory_order_relaxed);
+        snapshot.max_ = max_.load(std::memory_order_relaxed);
+        snapshot.sum_ = static_cast<double>(
+            sum_.load(std::memory_order_relaxed)
+        );
+    }
+    return snapshot;
+}
+
+} // namespace NetworkMonitor
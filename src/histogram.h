@@ -0,0 +1,128 @@
+#ifndef NETWORK_MONITOR_HISTOGRAM_H
+#define NETWORK_MONITOR_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief Log-linear histogram of integer values, in the style of
+ *         HdrHistogram.
+ *
+ *  Values below 2^(subBucketBits + 1) have a bucket each. Above that, every
+ *  power of two is split into 2^subBucketBits equal buckets, so a recorded
+ *  value is known to within 1/2^subBucketBits of its magnitude, whatever
+ *  that magnitude is: under 1% with the default kSubBucketBits. Recording is
+ *  a couple of shifts and an increment; the bucket array is allocated once.
+ *
+ *  \note This class is not thread safe. Record into one histogram per thread
+ *        and Merge() them.
+ */
+class Histogram {
+public:
+    static constexpr unsigned kSubBucketBits {7};
+
+    Histogram();
+
+    /*! \brief Construct an empty histogram of a given precision.
+     *
+     *  \param subBucketBits Each step down halves the memory and doubles the
+     *                       relative error.
+     */
+    explicit Histogram(unsigned subBucketBits);
+
+    /*! \brief Add a value, typically a latency in nanoseconds.
+     */
+    void Record(std::uint64_t value);
+
+    /*! \brief Add all the values of another histogram, which must have
+     *         the same precision.
+     */
+    void Merge(const Histogram& other);
+
+    /*! \brief Forget all values.
+     */
+    void Reset();
+
+    std::uint64_t GetCount() const;
+    std::uint64_t GetMin() const;
+    std::uint64_t GetMax() const;
+    double GetMean() const;
+
+    /*! \brief Value below or at which the given percentage of the values
+     *         fall, e.g. 99.9.
+     *
+     *  The result is the upper bound of the bucket holding that value, so it
+     *  errs on the high side by less than the histogram precision.
+     *
+     *  \returns 0 if the histogram is empty.
+     */
+    std::uint64_t GetValueAtPercentile(double percentile) const;
+
+    /*! \brief Number of values in the buckets up to the one holding value.
+     *
+     *  Exact when value is the upper bound of a bucket, as 2^k - 1 always
+     *  is. This is what a Prometheus "le" bucket counts.
+     */
+    std::uint64_t GetCountAtOrBelow(std::uint64_t value) const;
+
+    double GetSum() const;
+
+private:
+    friend class AtomicHistogram;
+
+    unsigned subBucketBits_;
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t count_ {0};
+    std::uint64_t min_ {0};
+    std::uint64_t max_ {0};
+    double sum_ {0};
+};
+
+/*! \brief Histogram that one thread records into while others read it.
+ *
+ *  It has the buckets of a Histogram, held in relaxed atomics. With a single
+ *  writer, recording needs no lock and no read-modify-write instruction:
+ *  only plain loads and stores, as cheap as with Histogram. Readers copy the
+ *  counts into a Histogram with Snapshot(). A value recorded meanwhile may
+ *  be in the copy's buckets but not yet in its min, max or sum.
+ *
+ *  The default precision is coarse (19%), so that a histogram takes 2 KB
+ *  and there can be several per connection.
+ *
+ *  \note Record() must always be called from the same thread, or under the
+ *        same strand.
+ */
+class AtomicHistogram {
+public:
+    static constexpr unsigned kDefaultSubBucketBits {2};
+
+    explicit AtomicHistogram(unsigned subBucketBits = kDefaultSubBucketBits);
+
+    AtomicHistogram(const AtomicHistogram&) = delete;
+    AtomicHistogram& operator=(const AtomicHistogram&) = delete;
+
+    void Record(std::uint64_t value);
+
+    /*! \brief Copy of the values recorded so far.
+     *
+     *  \note This function is thread safe.
+     */
+    Histogram Snapshot() const;
+
+private:
+    unsigned subBucketBits_;
+    std::size_t nBuckets_;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> counts_;
+    std::atomic<std::uint64_t> count_ {0};
+    std::atomic<std::uint64_t> min_ {0};
+    std::atomic<std::uint64_t> max_ {0};
+    std::atomic<std::uint64_t> sum_ {0};
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_HISTOGRAM_H
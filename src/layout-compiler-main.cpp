@@ -0,0 +1,45 @@
+#include "network-layout.h"
+
+#include <iostream>
+#include <string>
+
+using NetworkMonitor::NetworkLayout;
+
+/* Compile network-layout.json into a binary snapshot that the monitor can
+   map at startup instead of parsing the JSON.
+
+   Usage: layout-compiler <layout.json> <snapshot> */
+int main(int argc, char* argv[])
+{
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <layout.json> <snapshot>"
+                  << std::endl;
+        return 1;
+    }
+    boost::system::error_code ec {};
+    const auto layout {NetworkLayout::FromFile(argv[1], ec)};
+    if (ec) {
+        std::cerr << "Could not load " << argv[1] << ": " << ec.message()
+                  << std::endl;
+        return 1;
+    }
+    layout.WriteSnapshot(argv[2], ec);
+    if (ec) {
+        std::cerr << "Could not write " << argv[2] << ": " << ec.message()
+                  << std::endl;
+        return 1;
+    }
+
+    // Read it back, so that a bad snapshot never gets deployed.
+    const auto check {NetworkLayout::FromSnapshot(argv[2], ec)};
+    if (ec || check.GetStationCount() != layout.GetStationCount() ||
+        check.GetEdgeCount() != layout.GetEdgeCount()) {
+        std::cerr << "The snapshot does not load back" << std::endl;
+        return 1;
+    }
+    std::cout << argv[2] << ": " << layout.GetStationCount() << " stations, "
+              << layout.GetLineCount() << " lines, "
+              << layout.GetRouteCount() << " routes, "
+              << layout.GetEdgeCount() << " edges" << std::endl;
+    return 0;
+}
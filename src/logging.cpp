@@ -1,9 +1,279 @@
 #include "logging.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <functional>
+
+namespace NetworkMonitor {
+
+constexpr std::size_t LogRecord::kDetailBytes;
+constexpr std::size_t LogRing::kCapacity;
+
+namespace {
+
+// Keeps the calling thread's ring alive while the thread runs and tells the
+// writer it can be reclaimed once the thread is gone.
+struct ThreadRing {
+    std::shared_ptr<LogRing> ring {};
+
+    ~ThreadRing()
+    {
+        if (ring) {
+            ring->Abandon();
+        }
+    }
+};
+
+thread_local ThreadRing threadRing {};
+thread_local const std::uint64_t threadId {
+    std::hash<std::thread::id> {}(std::this_thread::get_id())
+};
+
+const char* ToString(LogLevel level)
+{
+    switch (level) {
+    case LogLevel::Debug:
+        return "DEBUG";
+    case LogLevel::Info:
+        return "INFO";
+    case LogLevel::Warning:
+        return "WARN";
+    case LogLevel::Error:
+        return "ERROR";
+    }
+    return "?";
+}
+
+} // namespace
+
+bool LogRing::TryPush(const LogRecord& record)
+{
+    const auto tail {tail_.load(std::memory_order_relaxed)};
+    if (tail - head_.load(std::memory_order_acquire) == kCapacity) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    records_[tail % kCapacity] = record;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogRing::TryPop(LogRecord& record)
+{
+    const auto head {head_.load(std::memory_order_relaxed)};
+    if (head == tail_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    record = records_[head % kCapacity];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogRing::IsEmpty() const
+{
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+}
+
+std::uint64_t LogRing::TakeDropped()
+{
+    return dropped_.exchange(0, std::memory_order_relaxed);
+}
+
+void LogRing::Abandon()
+{
+    abandoned_.store(true, std::memory_order_release);
+}
+
+bool LogRing::IsAbandoned() const
+{
+    return abandoned_.load(std::memory_order_acquire);
+}
+
+Logger& Logger::Get()
+{
+    static Logger logger {};
+    return logger;
+}
+
+Logger::Logger()
+{
+    line_.reserve(256);
+    writer_ = std::thread {[this]() { Run(); }};
+}
+
+Logger::~Logger()
+{
+    {
+        std::lock_guard<std::mutex> lock {wakeMutex_};
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+}
+
+void Logger::Push(
+    LogLevel level,
+    const char* message,
+    boost::system::error_code ec,
+    boost::beast::string_view detail
+)
+{
+    LogRecord record;
+    record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    record.threadId = threadId;
+    record.level = level;
+    record.message = message;
+    if (ec) {
+        record.errorCategory = &ec.category();
+        record.errorValue = ec.value();
+    }
+    record.detailSize = static_cast<std::uint16_t>(
+        std::min(detail.size(), LogRecord::kDetailBytes)
+    );
+    std::memcpy(record.detail, detail.data(), record.detailSize);
+    GetThreadRing().TryPush(record);
+}
+
+void Logger::Push(
+    LogLevel level,
+    const char* message,
+    boost::beast::string_view detail
+)
+{
+    Push(level, message, {}, detail);
+}
+
+void Logger::Flush()
+{
+    while (Drain()) {
+    }
+}
+
+void Logger::SetSink(std::ostream& sink)
+{
+    std::lock_guard<std::mutex> lock {drainMutex_};
+    sink_->flush();
+    sink_ = &sink;
+}
+
+LogRing& Logger::GetThreadRing()
+{
+    // Only the first record of each thread takes the lock.
+    if (!threadRing.ring) {
+        threadRing.ring = std::make_shared<LogRing>();
+        std::lock_guard<std::mutex> lock {ringsMutex_};
+        rings_.push_back(threadRing.ring);
+    }
+    return *threadRing.ring;
+}
+
+void Logger::Run()
+{
+    // Poll the rings: producers never touch a mutex or a condition variable,
+    // so the writer cannot be woken up by them.
+    static constexpr std::chrono::milliseconds kIdleWait {2};
+    while (true) {
+        const bool wrote {Drain()};
+        std::unique_lock<std::mutex> lock {wakeMutex_};
+        if (stopping_) {
+            break;
+        }
+        if (!wrote) {
+            wake_.wait_for(lock, kIdleWait);
+        }
+    }
+    Flush();
+}
+
+bool Logger::Drain()
+{
+    std::lock_guard<std::mutex> drainLock {drainMutex_};
+    {
+        std::lock_guard<std::mutex> lock {ringsMutex_};
+
+        // A ring whose thread has exited and that we fully drained before
+        // will not receive any more records.
+        rings_.erase(
+            std::remove_if(rings_.begin(), rings_.end(),
+                [](const auto& ring) {
+                    return ring->IsAbandoned() && ring->IsEmpty();
+                }),
+            rings_.end()
+        );
+        draining_ = rings_;
+    }
+
+    bool wrote {false};
+    LogRecord record;
+    for (const auto& ring: draining_) {
+        if (const auto dropped {ring->TakeDropped()}) {
+            *sink_ << "[logger] dropped " << dropped
+                   << " records: ring buffer full\n";
+            wrote = true;
+        }
+        while (ring->TryPop(record)) {
+            Format(record);
+            sink_->write(line_.data(), line_.size());
+            wrote = true;
+        }
+    }
+    draining_.clear();
+    if (wrote) {
+        sink_->flush();
+    }
+    return wrote;
+}
+
+void Logger::Format(const LogRecord& record)
+{
+    const auto seconds {static_cast<std::time_t>(record.timestamp / 1000000000)};
+    const auto micros {static_cast<long>(record.timestamp % 1000000000 / 1000)};
+    std::tm utc {};
+#ifdef _WIN32
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    char prefix[96];
+    const auto prefixSize {std::snprintf(
+        prefix, sizeof(prefix),
+        "%04d-%02d-%02dT%02d:%02d:%02d.%06ldZ [%14llx] %-5s ",
+        utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+        utc.tm_hour, utc.tm_min, utc.tm_sec, micros,
+        static_cast<unsigned long long>(record.threadId),
+        ToString(record.level)
+    )};
+
+    line_.assign(prefix, static_cast<std::size_t>(prefixSize));
+    line_ += record.message ? record.message : "";
+    if (record.detailSize > 0) {
+        line_ += ' ';
+        line_.append(record.detail, record.detailSize);
+    }
+    if (record.errorCategory) {
+        line_ += " [";
+        line_ += record.errorCategory->name();
+        line_ += ':';
+        line_ += std::to_string(record.errorValue);
+        line_ += "] ";
+        line_ += record.errorCategory->message(record.errorValue);
+    }
+    line_ += '\n';
+}
+
+} // namespace NetworkMonitor
+
 void Log(boost::system::error_code ec)
 {
-    std::cerr << "[" << std::setw(14) << std::this_thread::get_id() << "] "
-              << (ec ? "Error: " : "OK")
-              << (ec ? ec.message() : "")
-              << std::endl;
+    if (ec) {
+        NM_LOG_ERROR("Error:", ec);
+    } else {
+        NM_LOG_INFO("OK");
+    }
 }
@@ -1,5 +1,194 @@
+#ifndef NETWORK_MONITOR_LOGGING_H
+#define NETWORK_MONITOR_LOGGING_H
+
 #include <boost/asio.hpp>
+#include <boost/beast/core/string.hpp>
 #include <boost/system/error_code.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
-void Log(boost::system::error_code ec);
\ No newline at end of file
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Compile-time log level. Calls below this level expand to nothing, so they
+   cost neither the call nor the evaluation of their arguments.
+   0: debug, 1: info, 2: warning, 3: error, 4: off. */
+#ifndef NETWORK_MONITOR_LOG_LEVEL
+#define NETWORK_MONITOR_LOG_LEVEL 1
+#endif
+
+#if NETWORK_MONITOR_LOG_LEVEL <= 0
+#define NM_LOG_DEBUG(...) ::NetworkMonitor::Logger::Get().Push( \
+    ::NetworkMonitor::LogLevel::Debug, __VA_ARGS__)
+#else
+#define NM_LOG_DEBUG(...) do {} while (0)
+#endif
+
+#if NETWORK_MONITOR_LOG_LEVEL <= 1
+#define NM_LOG_INFO(...) ::NetworkMonitor::Logger::Get().Push( \
+    ::NetworkMonitor::LogLevel::Info, __VA_ARGS__)
+#else
+#define NM_LOG_INFO(...) do {} while (0)
+#endif
+
+#if NETWORK_MONITOR_LOG_LEVEL <= 2
+#define NM_LOG_WARNING(...) ::NetworkMonitor::Logger::Get().Push( \
+    ::NetworkMonitor::LogLevel::Warning, __VA_ARGS__)
+#else
+#define NM_LOG_WARNING(...) do {} while (0)
+#endif
+
+#if NETWORK_MONITOR_LOG_LEVEL <= 3
+#define NM_LOG_ERROR(...) ::NetworkMonitor::Logger::Get().Push( \
+    ::NetworkMonitor::LogLevel::Error, __VA_ARGS__)
+#else
+#define NM_LOG_ERROR(...) do {} while (0)
+#endif
+
+namespace NetworkMonitor {
+
+/*! \brief Severity of a log record.
+ */
+enum class LogLevel : std::uint8_t {
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3,
+};
+
+/*! \brief A single log record, as stored in the per-thread ring buffers.
+ *
+ *  Records are plain data with a fixed size: pushing one never allocates.
+ *  Formatting, including turning the error code into text, happens on the
+ *  writer thread.
+ */
+struct LogRecord {
+    static constexpr std::size_t kDetailBytes {96};
+
+    std::int64_t timestamp {0}; // Nanoseconds since the Unix epoch.
+    std::uint64_t threadId {0};
+    const char* message {nullptr}; // Must point to a string literal.
+    const boost::system::error_category* errorCategory {nullptr};
+    int errorValue {0};
+    std::uint16_t detailSize {0};
+    LogLevel level {LogLevel::Info};
+    char detail[kDetailBytes];
+};
+
+/*! \brief Single-producer, single-consumer ring of log records.
+ *
+ *  Each producing thread owns one ring; the logger's writer thread is the
+ *  only consumer. When the ring is full new records are dropped and counted,
+ *  the producer never waits.
+ */
+class LogRing {
+public:
+    static constexpr std::size_t kCapacity {1024};
+
+    bool TryPush(const LogRecord& record);
+    bool TryPop(LogRecord& record);
+    bool IsEmpty() const;
+
+    std::uint64_t TakeDropped();
+    void Abandon();
+    bool IsAbandoned() const;
+
+private:
+    std::vector<LogRecord> records_ = std::vector<LogRecord>(kCapacity);
+    alignas(64) std::atomic<std::size_t> head_ {0}; // Next slot to read.
+    alignas(64) std::atomic<std::size_t> tail_ {0}; // Next slot to write.
+    std::atomic<std::uint64_t> dropped_ {0};
+    std::atomic<bool> abandoned_ {false};
+};
+
+/*! \brief Asynchronous logger.
+ *
+ *  Producers copy a LogRecord into a ring buffer owned by their thread. A
+ *  background thread drains all rings and writes the formatted records to the
+ *  sink, so I/O callbacks never block on a terminal or a pipe.
+ *
+ *  Use the NM_LOG_* macros rather than calling Push() directly: they honour
+ *  the compile-time NETWORK_MONITOR_LOG_LEVEL.
+ */
+class Logger {
+public:
+    /*! \brief Get the process-wide logger. Starts the writer thread on first
+     *         use.
+     */
+    static Logger& Get();
+
+    /*! \brief Destructor. Writes out all pending records.
+     */
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /*! \brief Queue a log record. Does not allocate, lock or block.
+     *
+     *  \param level   The record severity.
+     *  \param message A string literal. Only the pointer is stored.
+     *  \param ec      Optional error code attached to the record.
+     *  \param detail  Optional text copied into the record. It is truncated
+     *                 to LogRecord::kDetailBytes.
+     */
+    void Push(
+        LogLevel level,
+        const char* message,
+        boost::system::error_code ec = {},
+        boost::beast::string_view detail = {}
+    );
+
+    /*! \brief Queue a log record with a detail string and no error code.
+     */
+    void Push(
+        LogLevel level,
+        const char* message,
+        boost::beast::string_view detail
+    );
+
+    /*! \brief Block until all the records queued so far have been written.
+     */
+    void Flush();
+
+    /*! \brief Write to a different stream. Defaults to std::cerr.
+     *
+     *  \note The stream must outlive the logger or the next call to SetSink.
+     */
+    void SetSink(std::ostream& sink);
+
+private:
+    std::mutex ringsMutex_ {};
+    std::vector<std::shared_ptr<LogRing>> rings_ {};
+
+    // Held by whoever drains the rings, to keep them single-consumer.
+    std::mutex drainMutex_ {};
+    std::vector<std::shared_ptr<LogRing>> draining_ {};
+    std::ostream* sink_ {&std::cerr};
+    std::string line_ {};
+
+    std::mutex wakeMutex_ {};
+    std::condition_variable wake_ {};
+    bool stopping_ {false};
+    std::thread writer_ {};
+
+    Logger();
+
+    LogRing& GetThreadRing();
+    void Run();
+    bool Drain();
+    void Format(const LogRecord& record);
+};
+
+} // namespace NetworkMonitor
+
+/*! \brief Log the outcome of an operation.
+ */
+void Log(boost::system::error_code ec);
+
+#endif // NETWORK_MONITOR_LOGGING_H
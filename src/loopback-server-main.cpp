@@ -0,0 +1,67 @@
+#include "loopback-server.h"
+
+#include <boost/asio.hpp>
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NetworkMonitor::LoopbackMode;
+using NetworkMonitor::LoopbackServer;
+using NetworkMonitor::LoopbackServerOptions;
+
+/* Local WebSocket server to run the client and its benchmarks against,
+   until interrupted with Ctrl-C.
+
+   Usage: loopback-server [echo|flood] [port] [message-bytes]
+                          [messages-per-second] [n-threads] [deflate] */
+int main(int argc, char* argv[])
+{
+    LoopbackServerOptions options {};
+    const std::string mode {argc > 1 ? argv[1] : "echo"};
+    if (mode != "echo" && mode != "flood") {
+        std::cerr << "Usage: " << argv[0] << " [echo|flood] [port]"
+                  << " [message-bytes] [messages-per-second] [n-threads]"
+                  << " [deflate]"
+                  << std::endl;
+        return 1;
+    }
+    options.mode = mode == "echo" ? LoopbackMode::Echo : LoopbackMode::Flood;
+    options.port = static_cast<unsigned short>(
+        argc > 2 ? std::stoul(argv[2]) : 8080
+    );
+    options.messageBytes = argc > 3 ? std::stoul(argv[3]) : 256;
+    options.messagesPerSecond = argc > 4 ? std::stod(argv[4]) : 0;
+    const std::size_t nThreads {argc > 5 ? std::stoul(argv[5]) : 1};
+    options.compression.enabled = argc > 6 &&
+                                  std::string {argv[6]} == "deflate";
+
+    boost::asio::io_context ioc {static_cast<int>(nThreads)};
+    LoopbackServer server {ioc, options};
+    boost::system::error_code ec {};
+    server.Start(ec);
+    if (ec) {
+        std::cerr << "Could not listen: " << ec.message() << std::endl;
+        return 1;
+    }
+    std::cout << "Listening on " << options.address << ":"
+              << server.GetPort() << " (" << mode
+              << (options.compression.enabled ? ", deflate" : "") << ")"
+              << std::endl;
+
+    boost::asio::signal_set signals {ioc, SIGINT, SIGTERM};
+    signals.async_wait([&ioc](auto /*ec*/, int) {
+        ioc.stop();
+    });
+
+    std::vector<std::thread> threads {};
+    for (std::size_t idx {1}; idx < nThreads; ++idx) {
+        threads.emplace_back([&ioc]() { ioc.run(); });
+    }
+    ioc.run();
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include "loopback-server.h"
+
+#include "logging.h"
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <utility>
+
+using tcp = boost::asio::ip::tcp;
+namespace websocket = boost::beast::websocket;
+
+namespace NetworkMonitor {
+
+class LoopbackServer::Session:
+    public std::enable_shared_from_this<LoopbackServer::Session> {
+public:
+    Session(
+        tcp::socket&& socket,
+        const LoopbackServerOptions& options,
+        std::shared_ptr<const std::string> payload
+    ) : ws_ {std::move(socket)},
+        mode_ {options.mode},
+        messagesPerSecond_ {options.messagesPerSecond},
+        nMessages_ {options.nMessages},
+        payload_ {std::move(payload)},
+        timer_ {ws_.get_executor()}
+    {
+        ws_.set_option(MakePermessageDeflate(options.compression,
+                                             boost::beast::role_type::server));
+    }
+
+    void Start()
+    {
+        ws_.async_accept([self = shared_from_this()](auto ec) {
+            if (ec) {
+                NM_LOG_DEBUG("Loopback handshake failed", ec);
+                return;
+            }
+            self->Read();
+            if (self->mode_ == LoopbackMode::Flood) {
+                self->start_ = std::chrono::steady_clock::now();
+                self->Flood();
+            }
+        });
+    }
+
+    void Kill()
+    {
+        boost::asio::post(ws_.get_executor(), [self = shared_from_this()]() {
+            self->timer_.cancel();
+            boost::beast::get_lowest_layer(self->ws_).close();
+        });
+    }
+
+private:
+    websocket::stream<boost::beast::tcp_stream> ws_;
+    LoopbackMode mode_;
+    double messagesPerSecond_;
+    std::size_t nMessages_;
+    std::shared_ptr<const std::string> payload_;
+    boost::beast::flat_buffer buffer_ {};
+    boost::asio::steady_timer timer_;
+    std::chrono::steady_clock::time_point start_ {};
+    std::size_t nSent_ {0};
+
+    void Read()
+    {
+        ws_.async_read(buffer_,
+            [self = shared_from_this()](auto ec, auto nBytes) {
+                if (ec) {
+                    self->timer_.cancel();
+                    return;
+                }
+                if (self->mode_ == LoopbackMode::Echo) {
+                    self->Echo();
+                    return;
+                }
+                self->buffer_.consume(nBytes);
+                self->Read();
+            }
+        );
+    }
+
+    void Echo()
+    {
+        ws_.text(ws_.got_text());
+        ws_.async_write(buffer_.data(),
+            [self = shared_from_this()](auto ec, auto nBytes) {
+                if (ec) {
+                    return;
+                }
+                self->buffer_.consume(nBytes);
+                self->Read();
+            }
+        );
+    }
+
+    void Flood()
+    {
+        if (nMessages_ > 0 && nSent_ == nMessages_) {
+            ws_.async_close(websocket::close_code::normal,
+                            [self = shared_from_this()](auto /*ec*/) {});
+            return;
+        }
+        if (messagesPerSecond_ > 0) {
+            // Pace against the start time rather than the previous write, so
+            // that a slow write is caught up on instead of lowering the rate.
+            const auto due {start_ + std::chrono::duration_cast<
+                std::chrono::steady_clock::duration
+            >(std::chrono::duration<double> {nSent_ / messagesPerSecond_})};
+            if (due > std::chrono::steady_clock::now()) {
+                timer_.expires_at(due);
+                timer_.async_wait([self = shared_from_this()](auto ec) {
+                    if (!ec) {
+                        self->Send();
+                    }
+                });
+                return;
+            }
+        }
+        Send();
+    }
+
+    void Send()
+    {
+        ++nSent_;
+        ws_.async_write(boost::asio::buffer(*payload_),
+            [self = shared_from_this()](auto ec, auto) {
+                if (!ec) {
+                    self->Flood();
+                }
+            }
+        );
+    }
+};
+
+LoopbackServer::LoopbackServer(
+    boost::asio::io_context& ioc,
+    LoopbackServerOptions options
+) : ioc_ {ioc},
+    options_ {std::move(options)},
+    payload_ {std::make_shared<const std::string>(options_.messageBytes, 'x')},
+    strand_ {boost::asio::make_strand(ioc)},
+    port_ {options_.port}
+{
+}
+
+LoopbackServer::~LoopbackServer() = default;
+
+void LoopbackServer::Start(boost::system::error_code& ec)
+{
+    const tcp::endpoint endpoint {
+        boost::asio::ip::make_address(options_.address, ec), port_
+    };
+    if (ec) {
+        return;
+    }
+    acceptor_ = std::make_unique<tcp::acceptor>(strand_);
+    acceptor_->open(endpoint.protocol(), ec);
+    if (!ec) {
+        acceptor_->set_option(tcp::acceptor::reuse_address(true), ec);
+    }
+    if (!ec) {
+        acceptor_->bind(endpoint, ec);
+    }
+    if (!ec) {
+        acceptor_->listen(boost::asio::socket_base::max_listen_connections,
+                          ec);
+    }
+    if (ec) {
+        NM_LOG_ERROR("Loopback server could not listen", ec);
+        acceptor_.reset();
+        return;
+    }
+    port_ = acceptor_->local_endpoint().port();
+    boost::asio::post(strand_, [this]() {
+        Accept();
+    });
+}
+
+void LoopbackServer::Stop()
+{
+    std::promise<void> done {};
+    boost::asio::post(strand_, [this, &done]() {
+        if (acceptor_) {
+            boost::system::error_code ignored {};
+            acceptor_->close(ignored);
+        }
+        std::lock_guard<std::mutex> lock {mutex_};
+        for (auto& weak: sessions_) {
+            if (auto session = weak.lock()) {
+                session->Kill();
+            }
+        }
+        sessions_.clear();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+unsigned short LoopbackServer::GetPort() const
+{
+    return port_;
+}
+
+std::size_t LoopbackServer::GetConnectionCount() const
+{
+    std::lock_guard<std::mutex> lock {mutex_};
+    std::size_t count {0};
+    for (const auto& session: sessions_) {
+        if (!session.expired()) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void LoopbackServer::Accept()
+{
+    // Each session gets its own strand, so a multi-threaded io_context serves
+    // them in parallel.
+    acceptor_->async_accept(boost::asio::make_strand(ioc_),
+        [this](auto ec, auto socket) {
+            if (ec) {
+                return;
+            }
+            auto session {std::make_shared<Session>(
+                std::move(socket), options_, payload_
+            )};
+            {
+                std::lock_guard<std::mutex> lock {mutex_};
+                sessions_.erase(
+                    std::remove_if(sessions_.begin(), sessions_.end(),
+                        [](const auto& weak) { return weak.expired(); }
+                    ),
+                    sessions_.end()
+                );
+                sessions_.push_back(session);
+            }
+            session->Start();
+            Accept();
+        }
+    );
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,125 @@
+#ifndef NETWORK_MONITOR_LOOPBACK_SERVER_H
+#define NETWORK_MONITOR_LOOPBACK_SERVER_H
+
+#include "compression-options.h"
+
+#include <boost/asio.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief What a LoopbackServer does with its connections.
+ */
+enum class LoopbackMode {
+    Echo,   // Send every message back as it came.
+    Flood,  // Ignore the client and send messages at a configured rate.
+};
+
+/*! \brief Configuration of a LoopbackServer.
+ */
+struct LoopbackServerOptions {
+    std::string address {"127.0.0.1"};
+
+    /*! \brief Port to listen on. 0 picks a free one: see GetPort().
+     */
+    unsigned short port {0};
+
+    LoopbackMode mode {LoopbackMode::Echo};
+
+    /*! \brief Flood: size of each message.
+     */
+    std::size_t messageBytes {256};
+
+    /*! \brief Flood: messages per second on each connection. 0 sends as fast
+     *         as the connection allows.
+     */
+    double messagesPerSecond {0};
+
+    /*! \brief Flood: messages sent on each connection before the server
+     *         closes it. 0: until the client goes away.
+     */
+    std::size_t nMessages {0};
+
+    /*! \brief permessage-deflate settings accepted from clients.
+     */
+    CompressionOptions compression {};
+};
+
+/*! \brief WebSocket server for local tests and benchmarks.
+ *
+ *  It echoes or floods at a known size and rate, so that the client can be
+ *  measured without depending on a remote server. It can also be stopped
+ *  abruptly and started again on the same port, to simulate a server
+ *  restart.
+ */
+class LoopbackServer {
+public:
+    /*! \brief Construct the server.
+     *
+     *  \note This constructor does not start listening.
+     *
+     *  \param ioc The io_context the server runs on. The user takes care of
+     *             calling ioc.run().
+     */
+    LoopbackServer(
+        boost::asio::io_context& ioc,
+        LoopbackServerOptions options = {}
+    );
+
+    /*! \brief Destructor.
+     *
+     *  \note Call Stop() first if the io_context is still running.
+     */
+    ~LoopbackServer();
+
+    LoopbackServer(const LoopbackServer&) = delete;
+    LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+    /*! \brief Listen and accept connections.
+     *
+     *  After a Stop() the server listens on the same port as before.
+     */
+    void Start(boost::system::error_code& ec);
+
+    /*! \brief Stop listening and drop every connection without a close
+     *         handshake, as a crashing server would.
+     *
+     *  \note Do not call this from a thread that runs the io_context: it
+     *        waits for the io_context to process the request.
+     */
+    void Stop();
+
+    /*! \brief The port the server listens on.
+     */
+    unsigned short GetPort() const;
+
+    /*! \brief Number of connections currently open.
+     */
+    std::size_t GetConnectionCount() const;
+
+private:
+    class Session;
+
+    boost::asio::io_context& ioc_;
+    LoopbackServerOptions options_;
+    std::shared_ptr<const std::string> payload_;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand_;
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor_ {};
+    std::atomic<unsigned short> port_ {0};
+
+    mutable std::mutex mutex_ {};
+    std::vector<std::weak_ptr<Session>> sessions_ {};
+
+    void Accept();
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_LOOPBACK_SERVER_H
@@ -1,18 +1,122 @@
 #include <boost/asio.hpp>
 #include <boost/system/error_code.hpp>
 
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <csignal>
 #include <iomanip>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
 #include <thread>
 
+#include "connection-pool.h"
 #include "websocket-client.h"
 #include "logging.h"
 
 using tcp = boost::asio::ip::tcp;
 
+namespace {
 
-int main()
+std::atomic<bool> gInterrupted {false};
+
+void PrintPoolUsage(const char* program)
+{
+  std::cerr << "Usage: " << program << " pool <url> <endpoint> <port>"
+            << " [n-connections] [n-threads] [cpu-list]"
+            << " [per-thread-context]" << std::endl;
+}
+
+// Parse a whole argument as a non-negative number.
+bool ParseCount(const char* text, std::size_t& value)
+{
+  const std::string_view view {text};
+  const auto [end, error] {
+    std::from_chars(view.data(), view.data() + view.size(), value)
+  };
+  return error == std::errc {} && end == view.data() + view.size();
+}
+
+/* Pool mode: open many connections on a pool of worker threads and count the
+   messages they receive, until interrupted with Ctrl-C.
+
+   Usage: network-monitor pool <url> <endpoint> <port> [n-connections]
+                               [n-threads] [cpu-list] [per-thread-context] */
+int RunPool(int argc, char* argv[])
+{
+  if (argc < 5) {
+    PrintPoolUsage(argv[0]);
+    return 1;
+  }
+  const std::string url {argv[2]};
+  const std::string endpoint {argv[3]};
+  const std::string port {argv[4]};
+  std::size_t nConnections {1};
+  if (argc > 5 && !ParseCount(argv[5], nConnections)) {
+    std::cerr << "Invalid number of connections: " << argv[5] << std::endl;
+    PrintPoolUsage(argv[0]);
+    return 1;
+  }
+
+  NetworkMonitor::ConnectionPoolOptions options {};
+  if (argc > 6 && !ParseCount(argv[6], options.nThreads)) {
+    std::cerr << "Invalid number of threads: " << argv[6] << std::endl;
+    PrintPoolUsage(argv[0]);
+    return 1;
+  }
+  if (argc > 7 && std::string {argv[7]} != "-") {
+    boost::system::error_code ec {};
+    options.cpuAffinity = NetworkMonitor::ParseCpuList(argv[7], ec);
+    if (ec) {
+      std::cerr << "Invalid CPU list: " << argv[7] << std::endl;
+      return 1;
+    }
+  }
+  options.ioContextPerThread = argc > 8 && std::string {argv[8]} == "1";
+
+  NetworkMonitor::ConnectionPool pool {options};
+  for (std::size_t idx {0}; idx < nConnections; ++idx) {
+    pool.AddConnection(url, endpoint, port,
+      [](boost::system::error_code ec) {
+        if (ec) {
+          NM_LOG_ERROR("Pool connection failed", ec);
+        }
+      }
+    );
+  }
+  std::cout << "Pool: " << nConnections << " connections on "
+            << pool.GetThreadCount() << " threads" << std::endl;
+
+  std::signal(SIGINT, [](int) { gInterrupted = true; });
+  using Clock = std::chrono::steady_clock;
+  auto lastReport {Clock::now()};
+  std::size_t nReceived {0};
+  NetworkMonitor::PooledMessage message {};
+  while (!gInterrupted) {
+    if (pool.Pop(message, std::chrono::milliseconds {100})) {
+      ++nReceived;
+    }
+    const auto now {Clock::now()};
+    const auto elapsed {std::chrono::duration<double>(now - lastReport)};
+    if (elapsed.count() >= 1.0) {
+      std::cout << nReceived / elapsed.count() << " messages/s" << std::endl;
+      nReceived = 0;
+      lastReport = now;
+    }
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
 {
+  if (argc > 1 && std::string {argv[1]} == "pool") {
+    return RunPool(argc, argv);
+  }
+
   std::cerr << "[" << std::setw(14) << std::this_thread::get_id() << "] main"
     << std::endl;
 
@@ -0,0 +1,382 @@
+#include "metrics-exporter.h"
+
+#include "logging.h"
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <sstream>
+
+using tcp = boost::asio::ip::tcp;
+namespace http = boost::beast::http;
+
+namespace NetworkMonitor {
+
+namespace {
+
+using Named = std::pair<std::string, WebSocketClientMetrics>;
+
+// Histogram buckets, as powers of two in nanoseconds: about 1 us, 4 us,
+// 16 us, ... up to 17 s. Bucket bounds of the client histograms fall on
+// powers of two, so the count of the values below 2^n is exact. Values are
+// whole nanoseconds: the bucket is labelled le="2^n - 1 ns".
+constexpr unsigned kFirstBucketBits {10};
+constexpr unsigned kLastBucketBits {34};
+constexpr unsigned kBucketStep {2};
+
+std::string EscapeLabel(const std::string& value)
+{
+    std::string escaped {};
+    for (const auto c: value) {
+        switch (c) {
+        case '\\': escaped += "\\\\"; break;
+        case '"': escaped += "\\\""; break;
+        case '\n': escaped += "\\n"; break;
+        default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+void WriteHeader(
+    std::ostream& out,
+    const char* name,
+    const char* type,
+    const char* help
+)
+{
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << ' ' << type << '\n';
+}
+
+void WriteValue(
+    std::ostream& out,
+    const char* name,
+    const std::vector<Named>& clients,
+    const char* type,
+    const char* help,
+    const std::function<std::uint64_t (const WebSocketClientMetrics&)>& get
+)
+{
+    WriteHeader(out, name, type, help);
+    for (const auto& client: clients) {
+        out << name << "{connection=\"" << client.first << "\"} "
+            << get(client.second) << '\n';
+    }
+}
+
+void WriteHistogram(
+    std::ostream& out,
+    const char* name,
+    const std::vector<Named>& clients,
+    const char* help,
+    const std::function<const Histogram& (const WebSocketClientMetrics&)>& get
+)
+{
+    WriteHeader(out, name, "histogram", help);
+    for (const auto& client: clients) {
+        const auto& histogram {get(client.second)};
+        const auto label {"{connection=\"" + client.first + "\""};
+        for (auto bits {kFirstBucketBits}; bits <= kLastBucketBits;
+             bits += kBucketStep) {
+            const auto bound {(std::uint64_t {1} << bits) - 1};
+            out << name << "_bucket" << label << ",le=\""
+                << static_cast<double>(bound) / 1e9 << "\"} "
+                << histogram.GetCountAtOrBelow(bound) << '\n';
+        }
+        out << name << "_bucket" << label << ",le=\"+Inf\"} "
+            << histogram.GetCount() << '\n'
+            << name << "_sum" << label << "} " << histogram.GetSum() / 1e9
+            << '\n'
+            << name << "_count" << label << "} " << histogram.GetCount()
+            << '\n';
+    }
+}
+
+} // namespace
+
+// MetricsRegistry
+
+void MetricsRegistry::Add(const std::string& name,
+                          const WebSocketClient& client)
+{
+    std::lock_guard<std::mutex> lock {mutex_};
+    clients_.emplace_back(EscapeLabel(name), &client);
+}
+
+void MetricsRegistry::Remove(const std::string& name)
+{
+    const auto escaped {EscapeLabel(name)};
+    std::lock_guard<std::mutex> lock {mutex_};
+    clients_.erase(
+        std::remove_if(clients_.begin(), clients_.end(),
+            [&escaped](const auto& client) {
+                return client.first == escaped;
+            }
+        ),
+        clients_.end()
+    );
+}
+
+std::string MetricsRegistry::FormatPrometheus() const
+{
+    // Take the snapshots first: the text is grouped by metric, not by
+    // client, and each client is only read once.
+    std::vector<Named> clients {};
+    {
+        std::lock_guard<std::mutex> lock {mutex_};
+        clients.reserve(clients_.size());
+        for (const auto& client: clients_) {
+            clients.emplace_back(client.first, client.second->GetMetrics());
+        }
+    }
+
+    std::ostringstream out {};
+    // Enough digits for a nanosecond sum of a few hours.
+    out.precision(13);
+    WriteValue(out, "nm_websocket_messages_received_total", clients,
+        "counter", "Messages received.",
+        [](const auto& m) { return m.traffic.messagesReceived; });
+    WriteValue(out, "nm_websocket_messages_sent_total", clients,
+        "counter", "Messages sent.",
+        [](const auto& m) { return m.traffic.messagesSent; });
+    WriteValue(out, "nm_websocket_payload_bytes_received_total", clients,
+        "counter", "Message payload bytes received, after decompression.",
+        [](const auto& m) { return m.traffic.rawBytesReceived; });
+    WriteValue(out, "nm_websocket_payload_bytes_sent_total", clients,
+        "counter", "Message payload bytes sent, before compression.",
+        [](const auto& m) { return m.traffic.rawBytesSent; });
+    WriteValue(out, "nm_websocket_wire_bytes_received_total", clients,
+        "counter", "Bytes read from the socket.",
+        [](const auto& m) { return m.traffic.wireBytesReceived; });
+    WriteValue(out, "nm_websocket_wire_bytes_sent_total", clients,
+        "counter", "Bytes written to the socket.",
+        [](const auto& m) { return m.traffic.wireBytesSent; });
+    WriteValue(out, "nm_websocket_read_loop_iterations_total", clients,
+        "counter", "Iterations of the read loop.",
+        [](const auto& m) { return m.readLoopIterations; });
+    WriteValue(out, "nm_websocket_connects_total", clients,
+        "counter", "Successful connections, reconnections included.",
+        [](const auto& m) { return m.connects; });
+    WriteValue(out, "nm_websocket_disconnects_total", clients,
+        "counter", "Connections lost or closed.",
+        [](const auto& m) { return m.disconnects; });
+    WriteValue(out, "nm_websocket_reconnects_total", clients,
+        "counter", "Connections re-established after a drop.",
+        [](const auto& m) { return m.reconnects; });
+    WriteValue(out, "nm_websocket_write_queue_messages", clients,
+        "gauge", "Messages waiting in the write queue.",
+        [](const auto& m) { return m.queuedMessages; });
+    WriteValue(out, "nm_websocket_write_queue_bytes", clients,
+        "gauge", "Bytes waiting in the write queue.",
+        [](const auto& m) { return m.queuedBytes; });
+    WriteValue(out, "nm_websocket_write_queue_max_messages", clients,
+        "gauge", "Highest number of messages seen in the write queue.",
+        [](const auto& m) { return m.maxQueuedMessages; });
+    WriteHistogram(out, "nm_websocket_resolve_seconds", clients,
+        "Time to resolve the server address.",
+        [](const auto& m) -> const Histogram& { return m.resolveTime; });
+    WriteHistogram(out, "nm_websocket_connect_seconds", clients,
+        "Time to establish the TCP connection.",
+        [](const auto& m) -> const Histogram& { return m.connectTime; });
+    WriteHistogram(out, "nm_websocket_handshake_seconds", clients,
+        "Time to complete the WebSocket handshake.",
+        [](const auto& m) -> const Histogram& { return m.handshakeTime; });
+    WriteHistogram(out, "nm_websocket_callback_seconds", clients,
+        "Time spent in user callbacks, blocking the connection.",
+        [](const auto& m) -> const Histogram& { return m.callbackTime; });
+    return out.str();
+}
+
+void MetricsRegistry::WriteFile(
+    const std::string& path,
+    boost::system::error_code& ec
+) const
+{
+    const auto text {FormatPrometheus()};
+    const auto staging {path + ".tmp"};
+    {
+        std::ofstream file {staging, std::ios::binary | std::ios::trunc};
+        file << text;
+        file.close();
+        if (!file) {
+            boost::system::error_code ignored {};
+            boost::filesystem::remove(staging, ignored);
+            ec = boost::system::errc::make_error_code(
+                boost::system::errc::io_error
+            );
+            return;
+        }
+    }
+    // Unlike std::rename, this replaces the previous file on Windows too.
+    boost::filesystem::rename(staging, path, ec);
+    if (ec) {
+        boost::system::error_code ignored {};
+        boost::filesystem::remove(staging, ignored);
+    }
+}
+
+// MetricsServer
+
+class MetricsServer::Session:
+    public std::enable_shared_from_this<MetricsServer::Session> {
+public:
+    Session(tcp::socket&& socket, const MetricsRegistry& registry)
+        : stream_ {std::move(socket)},
+          registry_ {registry}
+    {
+    }
+
+    void Start()
+    {
+        // A scraper that connects and says nothing must not keep the
+        // session around.
+        stream_.expires_after(std::chrono::seconds {10});
+        http::async_read(stream_, buffer_, request_,
+            [self = shared_from_this()](auto ec, auto) {
+                if (ec) {
+                    NM_LOG_DEBUG("Bad metrics request", ec);
+                    return;
+                }
+                self->Respond();
+            }
+        );
+    }
+
+private:
+    boost::beast::tcp_stream stream_;
+    const MetricsRegistry& registry_;
+    boost::beast::flat_buffer buffer_ {};
+    http::request<http::empty_body> request_ {};
+    http::response<http::string_body> response_ {};
+
+    void Respond()
+    {
+        response_.version(request_.version());
+        response_.keep_alive(false);
+        const auto target {request_.target()};
+        if (request_.method() != http::verb::get) {
+            response_.result(http::status::method_not_allowed);
+        } else if (target != "/metrics" && target != "/") {
+            response_.result(http::status::not_found);
+        } else {
+            response_.result(http::status::ok);
+            response_.set(http::field::content_type,
+                          "text/plain; version=0.0.4; charset=utf-8");
+            response_.body() = registry_.FormatPrometheus();
+        }
+        response_.prepare_payload();
+        http::async_write(stream_, response_,
+            [self = shared_from_this()](auto /*ec*/, auto) {
+                boost::system::error_code ignored {};
+                self->stream_.socket().shutdown(tcp::socket::shutdown_send,
+                                                ignored);
+            }
+        );
+    }
+};
+
+MetricsServer::MetricsServer(
+    boost::asio::io_context& ioc,
+    const MetricsRegistry& registry,
+    std::string address,
+    unsigned short port
+) : ioc_ {ioc},
+    registry_ {registry},
+    address_ {std::move(address)},
+    port_ {port},
+    acceptor_ {boost::asio::make_strand(ioc)}
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    // A stopped io_context never runs the pending accept handler.
+    if (!ioc_.stopped()) {
+        Stop();
+    }
+}
+
+void MetricsServer::Start(boost::system::error_code& ec)
+{
+    const tcp::endpoint endpoint {
+        boost::asio::ip::make_address(address_, ec), port_
+    };
+    if (ec) {
+        return;
+    }
+    acceptor_.open(endpoint.protocol(), ec);
+    if (!ec) {
+        acceptor_.set_option(tcp::acceptor::reuse_address(true), ec);
+    }
+    if (!ec) {
+        acceptor_.bind(endpoint, ec);
+    }
+    if (!ec) {
+        acceptor_.listen(boost::asio::socket_base::max_listen_connections,
+                         ec);
+    }
+    if (ec) {
+        NM_LOG_ERROR("Metrics server could not listen", ec);
+        boost::system::error_code ignored {};
+        acceptor_.close(ignored);
+        return;
+    }
+    port_ = acceptor_.local_endpoint().port();
+    accepting_ = true;
+    boost::asio::post(acceptor_.get_executor(), [this]() {
+        Accept();
+    });
+}
+
+void MetricsServer::Stop()
+{
+    if (!accepting_) {
+        return;
+    }
+    // Closing the acceptor aborts the pending accept. Wait for its handler:
+    // it uses this.
+    std::promise<void> done {};
+    boost::asio::post(acceptor_.get_executor(), [this, &done]() {
+        boost::system::error_code ignored {};
+        acceptor_.close(ignored);
+        if (accepting_) {
+            onStopped_ = [&done]() { done.set_value(); };
+        } else {
+            done.set_value();
+        }
+    });
+    done.get_future().wait();
+}
+
+unsigned short MetricsServer::GetPort() const
+{
+    return port_;
+}
+
+void MetricsServer::Accept()
+{
+    acceptor_.async_accept(boost::asio::make_strand(ioc_),
+        [this](auto ec, auto socket) {
+            if (ec) {
+                accepting_ = false;
+                // Stop() may destroy this as soon as it is notified.
+                const auto onStopped {std::move(onStopped_)};
+                onStopped_ = nullptr;
+                if (onStopped) {
+                    onStopped();
+                }
+                return;
+            }
+            std::make_shared<Session>(std::move(socket), registry_)->Start();
+            Accept();
+        }
+    );
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,123 @@
+#ifndef NETWORK_MONITOR_METRICS_EXPORTER_H
+#define NETWORK_MONITOR_METRICS_EXPORTER_H
+
+#include "websocket-client.h"
+
+#include <boost/asio.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief The WebSocketClient instances whose metrics are exported, each
+ *         under a name that becomes its "connection" label.
+ *
+ *  \note This class is thread safe. Remove a client before destroying it.
+ */
+class MetricsRegistry {
+public:
+    void Add(const std::string& name, const WebSocketClient& client);
+    void Remove(const std::string& name);
+
+    /*! \brief Metrics of all the clients, in the Prometheus text exposition
+     *         format (version 0.0.4).
+     *
+     *  Durations are exported as histograms in seconds, as Prometheus
+     *  expects.
+     */
+    std::string FormatPrometheus() const;
+
+    /*! \brief Write FormatPrometheus() to a file, for example for the
+     *         node_exporter textfile collector.
+     *
+     *  The file is written next to its destination and renamed into place,
+     *  so a reader never sees it half written.
+     */
+    void WriteFile(
+        const std::string& path,
+        boost::system::error_code& ec
+    ) const;
+
+private:
+    mutable std::mutex mutex_ {};
+    std::vector<std::pair<std::string, const WebSocketClient*>> clients_ {};
+};
+
+/*! \brief Minimal HTTP server answering GET /metrics with the contents of a
+ *         MetricsRegistry, for Prometheus to scrape.
+ *
+ *  Each request gets one response and the connection is closed.
+ */
+class MetricsServer {
+public:
+    /*! \brief Construct the server.
+     *
+     *  \note This constructor does not start listening.
+     *
+     *  \param ioc      The io_context the server runs on. The user takes
+     *                  care of calling ioc.run().
+     *  \param registry The metrics to serve. It must outlive the server.
+     *  \param address  Address to listen on. Keep the default unless the
+     *                  scraper runs on another machine.
+     *  \param port     Port to listen on. 0 picks a free one: see GetPort().
+     */
+    MetricsServer(
+        boost::asio::io_context& ioc,
+        const MetricsRegistry& registry,
+        std::string address = "127.0.0.1",
+        unsigned short port = 0
+    );
+
+    /*! \brief Destructor. Calls Stop().
+     *
+     *  \note The io_context must be running, or stopped, when the server
+     *        goes away.
+     */
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    /*! \brief Listen and serve requests.
+     */
+    void Start(boost::system::error_code& ec);
+
+    /*! \brief Stop listening. Requests in progress are still answered.
+     *
+     *  Returns once the pending accept, if any, has completed.
+     *
+     *  \note Do not call this from a thread that runs the io_context: it
+     *        waits for the io_context to process the request.
+     */
+    void Stop();
+
+    unsigned short GetPort() const;
+
+private:
+    class Session;
+
+    boost::asio::io_context& ioc_;
+    const MetricsRegistry& registry_;
+    std::string address_;
+    std::atomic<unsigned short> port_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+
+    // Set while an accept, whose handler uses this, may be pending. Only
+    // the acceptor strand clears it; Stop() then learns of it through
+    // onStopped_.
+    std::atomic<bool> accepting_ {false};
+    std::function<void ()> onStopped_ {};
+
+    void Accept();
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_METRICS_EXPORTER_H
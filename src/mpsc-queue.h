@@ -0,0 +1,173 @@
+#ifndef NETWORK_MONITOR_MPSC_QUEUE_H
+#define NETWORK_MONITOR_MPSC_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace NetworkMonitor {
+
+/*! \brief Bounded lock-free queue for many producers and one consumer.
+ *
+ *  The queue is a ring of cells, each tagged with a sequence number that
+ *  tells whether the cell is free for the producer of a given position or
+ *  full for the consumer of that position. Producers claim positions with a
+ *  CAS on the tail; the consumer owns the head and never contends. Values
+ *  are moved in and out: the queue itself allocates only at construction.
+ *
+ *  The consumer can block in Pop() when the queue is empty. Producers only
+ *  touch the mutex when the consumer is actually asleep.
+ *
+ *  \note Push() and TryPush() may be called from any thread. TryPop() and
+ *        Pop() must always be called from the same thread.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    /*! \brief Construct the queue.
+     *
+     *  \param capacity Maximum number of queued values, rounded up to a
+     *                  power of two.
+     */
+    explicit MpscQueue(std::size_t capacity)
+    {
+        std::size_t size {2};
+        while (size < capacity) {
+            size *= 2;
+        }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (std::size_t idx {0}; idx < size; ++idx) {
+            cells_[idx].sequence.store(idx, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /*! \brief Queue a value if there is room for it.
+     *
+     *  \returns false if the queue is full. The value is left untouched in
+     *           that case.
+     */
+    bool TryPush(T& value)
+    {
+        auto pos {tail_.load(std::memory_order_relaxed)};
+        Cell* cell {nullptr};
+        while (true) {
+            cell = &cells_[pos & mask_];
+            const auto sequence {cell->sequence.load(std::memory_order_acquire)};
+            const auto diff {
+                static_cast<std::intptr_t>(sequence) -
+                static_cast<std::intptr_t>(pos)
+            };
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        // Pairs with the fence in Pop(): either the consumer sees our value
+        // or we see that it went to sleep.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed)) {
+            {
+                std::lock_guard<std::mutex> lock {mutex_};
+            }
+            wakeUp_.notify_one();
+        }
+        return true;
+    }
+
+    /*! \brief Take the oldest value, if any.
+     */
+    bool TryPop(T& value)
+    {
+        auto& cell {cells_[head_ & mask_]};
+        if (cell.sequence.load(std::memory_order_acquire) != head_ + 1) {
+            return false;
+        }
+        value = std::move(cell.value);
+        cell.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    /*! \brief Take the oldest value, waiting for one if the queue is empty.
+     *
+     *  \returns false if no value arrived before the timeout.
+     */
+    template <typename Rep, typename Period>
+    bool Pop(T& value, std::chrono::duration<Rep, Period> timeout)
+    {
+        if (TryPop(value)) {
+            return true;
+        }
+        const auto deadline {std::chrono::steady_clock::now() + timeout};
+        std::unique_lock<std::mutex> lock {mutex_};
+        bool popped {false};
+        while (true) {
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // A wake-up does not guarantee that the head is ready: we may
+            // have been woken by a producer further down the ring while the
+            // one in front of it is still writing.
+            popped = TryPop(value);
+            if (popped ||
+                wakeUp_.wait_until(lock, deadline) == std::cv_status::timeout) {
+                break;
+            }
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+        return popped || TryPop(value);
+    }
+
+    /*! \brief Maximum number of queued values.
+     */
+    std::size_t GetCapacity() const
+    {
+        return mask_ + 1;
+    }
+
+private:
+    // Padding keeps the producers' tail, the consumer's head and the cells
+    // on separate cache lines without needing over-aligned allocations.
+    static constexpr std::size_t kPadBytes {64};
+
+    struct Cell {
+        std::atomic<std::size_t> sequence {0};
+        T value {};
+    };
+
+    std::unique_ptr<Cell[]> cells_ {};
+    std::size_t mask_ {0};
+    char pad0_[kPadBytes] {};
+    std::atomic<std::size_t> tail_ {0};
+    char pad1_[kPadBytes] {};
+    std::size_t head_ {0};
+    char pad2_[kPadBytes] {};
+
+    std::atomic<bool> sleeping_ {false};
+    std::mutex mutex_ {};
+    std::condition_variable wakeUp_ {};
+};
+
+template <typename T>
+constexpr std::size_t MpscQueue<T>::kPadBytes;
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_MPSC_QUEUE_H
@@ -0,0 +1,355 @@
+#include "network-event-parser.h"
+
+#include <string>
+
+namespace NetworkMonitor {
+
+constexpr std::size_t NetworkEventParser::kDefaultMaxFrameBytes;
+
+namespace {
+
+class NetworkEventCategory: public boost::system::error_category {
+public:
+    const char* name() const noexcept override
+    {
+        return "network-event";
+    }
+
+    std::string message(int ev) const override
+    {
+        switch (static_cast<NetworkEventError>(ev)) {
+        case NetworkEventError::Success:
+            return "Success";
+        case NetworkEventError::FrameTooLarge:
+            return "Frame larger than the parser limit";
+        case NetworkEventError::MalformedFrame:
+            return "Malformed STOMP frame";
+        case NetworkEventError::MalformedBody:
+            return "Malformed JSON body";
+        case NetworkEventError::UnknownEvent:
+            return "Frame body is not a known network event";
+        }
+        return "Unknown error";
+    }
+};
+
+bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Single-pass scanner over a JSON text. It never builds values: strings are
+// returned as views into the input and other values can be skipped.
+class JsonScanner {
+public:
+    JsonScanner(const char* begin, const char* end)
+        : pos_ {begin},
+          end_ {end}
+    {
+    }
+
+    bool AtEnd()
+    {
+        SkipSpace();
+        return pos_ == end_;
+    }
+
+    bool Consume(char c)
+    {
+        SkipSpace();
+        if (pos_ != end_ && *pos_ == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    // The view holds the raw characters between the quotes. Escape sequences
+    // are not decoded: the feed ids and timestamps never contain any.
+    bool String(boost::beast::string_view& str)
+    {
+        if (!Consume('"')) {
+            return false;
+        }
+        const auto begin {pos_};
+        while (pos_ != end_ && *pos_ != '"') {
+            if (*pos_ == '\\' && ++pos_ == end_) {
+                return false;
+            }
+            ++pos_;
+        }
+        if (pos_ == end_) {
+            return false;
+        }
+        str = {begin, static_cast<std::size_t>(pos_ - begin)};
+        ++pos_;
+        return true;
+    }
+
+    bool Unsigned(std::uint32_t& value)
+    {
+        SkipSpace();
+        if (pos_ == end_ || *pos_ < '0' || *pos_ > '9') {
+            return false;
+        }
+        std::uint64_t result {0};
+        while (pos_ != end_ && *pos_ >= '0' && *pos_ <= '9') {
+            result = result * 10 + static_cast<std::uint64_t>(*pos_ - '0');
+            if (result > 0xFFFFFFFF) {
+                return false;
+            }
+            ++pos_;
+        }
+        value = static_cast<std::uint32_t>(result);
+        return true;
+    }
+
+    bool SkipValue()
+    {
+        SkipSpace();
+        if (pos_ == end_) {
+            return false;
+        }
+        if (*pos_ == '"') {
+            boost::beast::string_view ignored {};
+            return String(ignored);
+        }
+        if (*pos_ == '{' || *pos_ == '[') {
+            // Count brackets, minding the ones inside strings.
+            std::size_t depth {0};
+            while (pos_ != end_) {
+                if (*pos_ == '"') {
+                    boost::beast::string_view ignored {};
+                    if (!String(ignored)) {
+                        return false;
+                    }
+                    continue;
+                }
+                if (*pos_ == '{' || *pos_ == '[') {
+                    ++depth;
+                } else if (*pos_ == '}' || *pos_ == ']') {
+                    if (--depth == 0) {
+                        ++pos_;
+                        return true;
+                    }
+                }
+                ++pos_;
+            }
+            return false;
+        }
+        // Number, true, false or null.
+        const auto begin {pos_};
+        while (pos_ != end_ && !IsSpace(*pos_) &&
+               *pos_ != ',' && *pos_ != '}' && *pos_ != ']') {
+            ++pos_;
+        }
+        return pos_ != begin;
+    }
+
+private:
+    const char* pos_;
+    const char* end_;
+
+    void SkipSpace()
+    {
+        while (pos_ != end_ && IsSpace(*pos_)) {
+            ++pos_;
+        }
+    }
+};
+
+// Pop the next line off a frame, without its EOL (LF or CRLF).
+bool NextLine(
+    boost::beast::string_view& rest,
+    boost::beast::string_view& line
+)
+{
+    const auto eol {rest.find('\n')};
+    if (eol == boost::beast::string_view::npos) {
+        return false;
+    }
+    line = rest.substr(0, eol);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    rest.remove_prefix(eol + 1);
+    return true;
+}
+
+} // namespace
+
+const boost::system::error_category& GetNetworkEventCategory()
+{
+    static const NetworkEventCategory category {};
+    return category;
+}
+
+boost::system::error_code make_error_code(NetworkEventError error)
+{
+    return {static_cast<int>(error), GetNetworkEventCategory()};
+}
+
+void NetworkEvent::Clear()
+{
+    type = NetworkEventType::Unknown;
+    destination.Clear();
+    datetime.Clear();
+    stationId.Clear();
+    routeId.Clear();
+    passengers = 0;
+}
+
+NetworkEventParser::NetworkEventParser(
+    std::size_t maxFrameBytes
+) : maxFrameBytes_ {maxFrameBytes}
+{
+    carry_.reserve(maxFrameBytes_);
+}
+
+bool NetworkEventParser::ParseFrame(
+    boost::beast::string_view frame,
+    boost::system::error_code& ec
+)
+{
+    event_.Clear();
+    ec = {};
+
+    // Heart-beats are bare EOLs between frames.
+    while (!frame.empty() && (frame.front() == '\n' || frame.front() == '\r')) {
+        frame.remove_prefix(1);
+    }
+    if (frame.empty()) {
+        return false;
+    }
+
+    boost::beast::string_view line {};
+    if (!NextLine(frame, line)) {
+        ec = make_error_code(NetworkEventError::MalformedFrame);
+        return true;
+    }
+    if (line != "MESSAGE") {
+        return false;
+    }
+
+    // Headers, up to the blank line. STOMP says the first occurrence of a
+    // repeated header wins.
+    bool hasLength {false};
+    std::uint32_t length {0};
+    while (true) {
+        if (!NextLine(frame, line)) {
+            ec = make_error_code(NetworkEventError::MalformedFrame);
+            return true;
+        }
+        if (line.empty()) {
+            break;
+        }
+        const auto colon {line.find(':')};
+        if (colon == boost::beast::string_view::npos) {
+            ec = make_error_code(NetworkEventError::MalformedFrame);
+            return true;
+        }
+        const auto key {line.substr(0, colon)};
+        const auto value {line.substr(colon + 1)};
+        if (key == "destination" && event_.destination.IsEmpty()) {
+            event_.destination.Assign(value);
+        } else if (key == "content-length" && !hasLength) {
+            JsonScanner scanner {value.data(), value.data() + value.size()};
+            if (!scanner.Unsigned(length) || !scanner.AtEnd()) {
+                ec = make_error_code(NetworkEventError::MalformedFrame);
+                return true;
+            }
+            hasLength = true;
+        }
+    }
+    if (hasLength) {
+        if (length > frame.size()) {
+            ec = make_error_code(NetworkEventError::MalformedFrame);
+            return true;
+        }
+        frame = frame.substr(0, length);
+    }
+
+    if (!ParseBody(frame)) {
+        ec = make_error_code(NetworkEventError::MalformedBody);
+    } else if (event_.type == NetworkEventType::Unknown) {
+        ec = make_error_code(NetworkEventError::UnknownEvent);
+    }
+    return true;
+}
+
+const NetworkEvent& NetworkEventParser::GetEvent() const
+{
+    return event_;
+}
+
+void NetworkEventParser::Carry(const char* begin, const char* end)
+{
+    const auto nBytes {static_cast<std::size_t>(end - begin)};
+    if (overflow_ || carry_.size() + nBytes > maxFrameBytes_) {
+        // Drop the frame but remember it, so that we report it once we see
+        // its end.
+        overflow_ = true;
+        carry_.clear();
+        return;
+    }
+    carry_.insert(carry_.end(), begin, end);
+}
+
+bool NetworkEventParser::ParseBody(boost::beast::string_view body)
+{
+    JsonScanner scanner {body.data(), body.data() + body.size()};
+    if (!scanner.Consume('{')) {
+        return false;
+    }
+    if (scanner.Consume('}')) {
+        return scanner.AtEnd();
+    }
+    do {
+        boost::beast::string_view key {};
+        if (!scanner.String(key) || !scanner.Consume(':')) {
+            return false;
+        }
+        boost::beast::string_view value {};
+        bool ok {true};
+        if (key == "passenger_event") {
+            ok = scanner.String(value);
+            if (value == "in") {
+                event_.type = NetworkEventType::PassengerIn;
+            } else if (value == "out") {
+                event_.type = NetworkEventType::PassengerOut;
+            }
+        } else if (key == "train_event") {
+            ok = scanner.String(value);
+            if (value == "departure") {
+                event_.type = NetworkEventType::TrainDeparture;
+            } else if (value == "arrival") {
+                event_.type = NetworkEventType::TrainArrival;
+            }
+        } else if (key == "station_id") {
+            ok = scanner.String(value);
+            if (ok) {
+                event_.stationId.Assign(value);
+            }
+        } else if (key == "route_id") {
+            ok = scanner.String(value);
+            if (ok) {
+                event_.routeId.Assign(value);
+            }
+        } else if (key == "datetime") {
+            ok = scanner.String(value);
+            if (ok) {
+                event_.datetime.Assign(value);
+            }
+        } else if (key == "passengers") {
+            ok = scanner.Unsigned(event_.passengers);
+        } else {
+            ok = scanner.SkipValue();
+        }
+        if (!ok) {
+            return false;
+        }
+    } while (scanner.Consume(','));
+    return scanner.Consume('}') && scanner.AtEnd();
+}
+
+} // namespace NetworkMonitor
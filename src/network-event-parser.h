@@ -0,0 +1,219 @@
+#ifndef NETWORK_MONITOR_NETWORK_EVENT_PARSER_H
+#define NETWORK_MONITOR_NETWORK_EVENT_PARSER_H
+
+#include <boost/beast/core/string.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief String with inline storage. Longer values are truncated.
+ */
+template <std::size_t N>
+class FixedString {
+public:
+    void Assign(boost::beast::string_view str)
+    {
+        size_ = static_cast<std::uint8_t>(std::min(str.size(), N));
+        // An empty view may hold a null pointer, which memcpy must not see.
+        if (size_ > 0) {
+            std::memcpy(data_, str.data(), size_);
+        }
+    }
+
+    void Clear()
+    {
+        size_ = 0;
+    }
+
+    boost::beast::string_view View() const
+    {
+        return {data_, size_};
+    }
+
+    bool IsEmpty() const
+    {
+        return size_ == 0;
+    }
+
+private:
+    static_assert(N < 256, "FixedString stores its size in one byte");
+
+    char data_[N];
+    std::uint8_t size_ {0};
+};
+
+/*! \brief Kind of event carried by a network feed frame.
+ */
+enum class NetworkEventType : std::uint8_t {
+    Unknown,
+    PassengerIn,
+    PassengerOut,
+    TrainDeparture,
+    TrainArrival,
+};
+
+/*! \brief A passenger or train event, as sent by the network feed.
+ *
+ *  Passenger events:
+ *  {"datetime": "...", "passenger_event": "in"|"out", "station_id": "..."}
+ *
+ *  Train events:
+ *  {"datetime": "...", "train_event": "departure"|"arrival",
+ *   "route_id": "...", "station_id": "...", "passengers": 120}
+ *
+ *  All fields are stored inline so that events can live in preallocated
+ *  arrays and be reused without allocating.
+ */
+struct NetworkEvent {
+    NetworkEventType type {NetworkEventType::Unknown};
+    FixedString<64> destination {};
+    FixedString<32> datetime {};
+    FixedString<32> stationId {};
+    FixedString<32> routeId {};
+    std::uint32_t passengers {0};
+
+    void Clear();
+};
+
+/*! \brief Errors reported by the NetworkEventParser.
+ */
+enum class NetworkEventError {
+    Success = 0,
+    FrameTooLarge,
+    MalformedFrame,
+    MalformedBody,
+    UnknownEvent,
+};
+
+const boost::system::error_category& GetNetworkEventCategory();
+
+boost::system::error_code make_error_code(NetworkEventError error);
+
+/*! \brief Incremental parser for the STOMP frames of the network feed.
+ *
+ *  Each frame is a STOMP MESSAGE frame (command line, headers, blank line)
+ *  with a JSON body and a NUL terminator. Data can be fed in chunks of any
+ *  size: a frame may be split across reads and a read may hold many frames.
+ *
+ *  Complete frames are parsed straight out of the caller's buffer; the bytes
+ *  of a split frame are carried over in a buffer allocated once at
+ *  construction. The JSON body is scanned in a single pass and only the
+ *  fields we know about are extracted, directly into a reused NetworkEvent:
+ *  no DOM is built and parsing a frame never allocates.
+ *
+ *  Frames with other commands (CONNECTED, RECEIPT, ...) and heart-beat EOLs
+ *  are skipped.
+ */
+class NetworkEventParser {
+public:
+    /*! \brief Default upper bound for the size of a frame.
+     */
+    static constexpr std::size_t kDefaultMaxFrameBytes {64 * 1024};
+
+    /*! \brief Construct the parser.
+     *
+     *  \param maxFrameBytes Frames larger than this are dropped with
+     *                       NetworkEventError::FrameTooLarge.
+     */
+    explicit NetworkEventParser(
+        std::size_t maxFrameBytes = kDefaultMaxFrameBytes
+    );
+
+    /*! \brief Feed bytes received from the network.
+     *
+     *  \param data    The bytes. They are not referenced after the call.
+     *  \param onEvent Called with (error_code, const NetworkEvent&) for each
+     *                 MESSAGE frame completed by these bytes. The event is
+     *                 only valid during the call. On error the event holds
+     *                 whatever was parsed before the error.
+     *  \returns the number of frames reported to onEvent.
+     */
+    template <typename Handler>
+    std::size_t Feed(boost::beast::string_view data, Handler&& onEvent)
+    {
+        std::size_t nFrames {0};
+        const char* pos {data.data()};
+        const char* const end {data.data() + data.size()};
+        while (pos != end) {
+            const auto nul {static_cast<const char*>(
+                std::memchr(pos, '\0', static_cast<std::size_t>(end - pos))
+            )};
+            if (nul == nullptr) {
+                Carry(pos, end);
+                break;
+            }
+
+            boost::beast::string_view frame {
+                pos, static_cast<std::size_t>(nul - pos)
+            };
+            const bool carried {!carry_.empty() || overflow_};
+            if (carried) {
+                Carry(pos, nul);
+                frame = {carry_.data(), carry_.size()};
+            }
+            pos = nul + 1;
+
+            boost::system::error_code ec {};
+            bool report {true};
+            if (overflow_ || frame.size() > maxFrameBytes_) {
+                event_.Clear();
+                ec = make_error_code(NetworkEventError::FrameTooLarge);
+            } else {
+                report = ParseFrame(frame, ec);
+            }
+            if (carried) {
+                carry_.clear();
+                overflow_ = false;
+            }
+            if (report) {
+                ++nFrames;
+                onEvent(ec, static_cast<const NetworkEvent&>(event_));
+            }
+        }
+        return nFrames;
+    }
+
+    /*! \brief Parse one complete frame, without its NUL terminator.
+     *
+     *  \returns false if the frame was skipped (not a MESSAGE frame, or only
+     *           heart-beats). Otherwise the result is in GetEvent() and ec.
+     */
+    bool ParseFrame(
+        boost::beast::string_view frame,
+        boost::system::error_code& ec
+    );
+
+    /*! \brief The event parsed last.
+     */
+    const NetworkEvent& GetEvent() const;
+
+private:
+    std::size_t maxFrameBytes_;
+    std::vector<char> carry_ {};
+    bool overflow_ {false};
+    NetworkEvent event_ {};
+
+    void Carry(const char* begin, const char* end);
+    bool ParseBody(boost::beast::string_view body);
+};
+
+} // namespace NetworkMonitor
+
+namespace boost {
+namespace system {
+
+template <>
+struct is_error_code_enum<NetworkMonitor::NetworkEventError>
+    : std::true_type {};
+
+} // namespace system
+} // namespace boost
+
+#endif // NETWORK_MONITOR_NETWORK_EVENT_PARSER_H
@@ -0,0 +1,435 @@
+#include "network-layout.h"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+namespace NetworkMonitor {
+
+namespace {
+
+/* Snapshot file layout, in the byte order of the machine that wrote it:
+
+   SnapshotHeader
+   section 0, padded to 8 bytes
+   section 1, padded to 8 bytes
+   ...
+
+   Each section is one of the layout arrays, stored exactly as it is in
+   memory, so the loader can point a Span at it. The checksum covers
+   everything from the section table to the end of the file.
+
+   Bump kSnapshotVersion whenever the header, the sections, Edge, Route or
+   the string table hash change. */
+constexpr char kSnapshotMagic[8] {'N', 'M', 'L', 'A', 'Y', 'O', 'U', 'T'};
+constexpr std::uint32_t kSnapshotVersion {1};
+constexpr std::uint32_t kByteOrderMark {0x01020304};
+constexpr std::size_t kSectionAlignment {8};
+
+enum Section {
+    StationIdChars,
+    StationIdOffsets,
+    StationIdSlots,
+    StationNameChars,
+    StationNameOffsets,
+    StationNameSlots,
+    LineIdChars,
+    LineIdOffsets,
+    LineIdSlots,
+    LineNameChars,
+    LineNameOffsets,
+    LineNameSlots,
+    RouteIdChars,
+    RouteIdOffsets,
+    RouteIdSlots,
+    DirectionChars,
+    DirectionOffsets,
+    DirectionSlots,
+    EdgeOffsets,
+    Edges,
+    EdgeSources,
+    Routes,
+    RouteStops,
+    LineRouteOffsets,
+    LineRoutes,
+    StationRouteOffsets,
+    StationRoutes,
+    kSectionCount,
+};
+
+struct SnapshotSection {
+    std::uint64_t offset;
+    std::uint64_t size; // In bytes.
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t fileSize;
+    std::uint64_t checksum;
+    SnapshotSection sections[kSectionCount];
+};
+
+static_assert(std::is_trivially_copyable<Edge>::value &&
+              sizeof(Edge) == 16,
+              "Edge is stored as is in snapshots");
+static_assert(std::is_trivially_copyable<Route>::value &&
+              sizeof(Route) == 24,
+              "Route is stored as is in snapshots");
+static_assert(sizeof(SnapshotHeader) % kSectionAlignment == 0,
+              "Sections start aligned after the header");
+
+constexpr std::size_t kChecksumStart {offsetof(SnapshotHeader, sections)};
+
+// FNV-1a over 64-bit words. It only has to catch truncated or damaged
+// files, and runs at several GB/s.
+std::uint64_t Checksum(const char* data, std::size_t size)
+{
+    std::uint64_t hash {14695981039346656037ull};
+    std::size_t idx {0};
+    for (; idx + 8 <= size; idx += 8) {
+        std::uint64_t word {};
+        std::memcpy(&word, data + idx, 8);
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    for (; idx < size; ++idx) {
+        hash ^= static_cast<unsigned char>(data[idx]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+boost::system::error_code MakeError(boost::system::errc::errc_t error)
+{
+    return boost::system::errc::make_error_code(error);
+}
+
+class SnapshotWriter {
+public:
+    SnapshotWriter()
+        : image_(sizeof(SnapshotHeader), 0)
+    {
+    }
+
+    template <typename T>
+    void Add(Section section, Span<T> values)
+    {
+        const auto size {values.size() * sizeof(T)};
+        auto& entry {sections_[section]};
+        entry.offset = image_.size();
+        entry.size = size;
+        if (size > 0) {
+            const auto bytes {reinterpret_cast<const char*>(values.data())};
+            image_.insert(image_.end(), bytes, bytes + size);
+        }
+        image_.resize((image_.size() + kSectionAlignment - 1) /
+                      kSectionAlignment * kSectionAlignment, 0);
+    }
+
+    void Add(Section first, const StringTable& table)
+    {
+        Add(first, table.GetChars());
+        Add(static_cast<Section>(first + 1), table.GetOffsets());
+        Add(static_cast<Section>(first + 2), table.GetSlots());
+    }
+
+    const std::vector<char>& Finish()
+    {
+        SnapshotHeader header {};
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+        header.version = kSnapshotVersion;
+        header.byteOrder = kByteOrderMark;
+        header.fileSize = image_.size();
+        std::memcpy(header.sections, sections_, sizeof(sections_));
+        std::memcpy(image_.data(), &header, sizeof(header));
+        header.checksum = Checksum(image_.data() + kChecksumStart,
+                                   image_.size() - kChecksumStart);
+        std::memcpy(image_.data(), &header, sizeof(header));
+        return image_;
+    }
+
+private:
+    std::vector<char> image_;
+    SnapshotSection sections_[kSectionCount] {};
+};
+
+// The hash index of a string table: a power of two slots, each empty or
+// holding a string index. Lookups probe until they reach an empty slot, so
+// a non-empty index needs at least one.
+bool AreSlotsValid(Span<std::uint32_t> slots, std::size_t nStrings)
+{
+    if ((slots.size() & (slots.size() - 1)) != 0) {
+        return false;
+    }
+    bool hasEmptySlot {slots.empty()};
+    for (const auto slot: slots) {
+        if (slot == kInvalidIndex) {
+            hasEmptySlot = true;
+        } else if (slot >= nStrings) {
+            return false;
+        }
+    }
+    return hasEmptySlot;
+}
+
+class SnapshotReader {
+public:
+    SnapshotReader(const char* base, const SnapshotHeader& header)
+        : base_ {base},
+          header_ {header}
+    {
+    }
+
+    // Sections whose size is not a whole number of elements make the
+    // snapshot invalid.
+    template <typename T>
+    Span<T> Get(Section section)
+    {
+        const auto& entry {header_.sections[section]};
+        if (entry.size % sizeof(T) != 0 ||
+            entry.offset % kSectionAlignment != 0 ||
+            entry.offset > header_.fileSize ||
+            entry.size > header_.fileSize - entry.offset) {
+            valid_ = false;
+            return {};
+        }
+        return {reinterpret_cast<const T*>(base_ + entry.offset),
+                static_cast<std::size_t>(entry.size / sizeof(T))};
+    }
+
+    void Attach(Section first, StringTable& table)
+    {
+        const auto chars {Get<char>(first)};
+        const auto offsets {
+            Get<std::uint32_t>(static_cast<Section>(first + 1))
+        };
+        const auto slots {Get<std::uint32_t>(static_cast<Section>(first + 2))};
+        if (offsets.empty() || offsets[offsets.size() - 1] != chars.size() ||
+            !std::is_sorted(offsets.begin(), offsets.end()) ||
+            !AreSlotsValid(slots, offsets.size() - 1)) {
+            valid_ = false;
+            return;
+        }
+        table.Attach(chars, offsets, slots);
+    }
+
+    bool IsValid() const
+    {
+        return valid_;
+    }
+
+private:
+    const char* base_;
+    const SnapshotHeader& header_;
+    bool valid_ {true};
+};
+
+// A CSR offsets array must have one entry per key plus one, never decrease
+// and end at the size of the values.
+template <typename T>
+bool IsCsr(Span<std::uint32_t> offsets, std::size_t nKeys, Span<T> values)
+{
+    if (offsets.size() != nKeys + 1 ||
+        offsets[offsets.size() - 1] != values.size()) {
+        return false;
+    }
+    return std::is_sorted(offsets.begin(), offsets.end());
+}
+
+// Every index in values must be below n.
+template <typename T>
+bool AllBelow(Span<T> values, std::size_t n)
+{
+    return std::all_of(values.begin(), values.end(),
+        [n](T value) { return value < n; }
+    );
+}
+
+bool AreEdgesValid(
+    Span<Edge> edges,
+    std::size_t nStations,
+    std::size_t nLines,
+    std::size_t nRoutes
+)
+{
+    return std::all_of(edges.begin(), edges.end(),
+        [=](const Edge& edge) {
+            return edge.to < nStations && edge.line < nLines &&
+                   edge.route < nRoutes;
+        }
+    );
+}
+
+bool AreRoutesValid(
+    Span<Route> routes,
+    std::size_t nStations,
+    std::size_t nLines,
+    std::size_t nDirections,
+    std::size_t nRouteStops
+)
+{
+    return std::all_of(routes.begin(), routes.end(),
+        [=](const Route& route) {
+            return route.line < nLines && route.start < nStations &&
+                   route.end < nStations && route.direction < nDirections &&
+                   route.firstStop <= nRouteStops &&
+                   route.stopCount <= nRouteStops - route.firstStop;
+        }
+    );
+}
+
+} // namespace
+
+NetworkLayout NetworkLayout::FromSnapshot(
+    const std::string& path,
+    boost::system::error_code& ec,
+    bool verify
+)
+{
+    namespace ipc = boost::interprocess;
+    ec = {};
+    std::shared_ptr<ipc::mapped_region> region {};
+    try {
+        const ipc::file_mapping file {path.c_str(), ipc::read_only};
+        // The mapping outlives the file handle.
+        region = std::make_shared<ipc::mapped_region>(file, ipc::read_only);
+    } catch (const ipc::interprocess_exception& e) {
+        ec = {e.get_native_error(), boost::system::system_category()};
+        if (!ec) {
+            ec = MakeError(boost::system::errc::io_error);
+        }
+        return NetworkLayout {};
+    }
+
+    const auto base {static_cast<const char*>(region->get_address())};
+    const auto size {region->get_size()};
+    SnapshotHeader header {};
+    if (size < sizeof(header)) {
+        ec = MakeError(boost::system::errc::invalid_argument);
+        return NetworkLayout {};
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0) {
+        ec = MakeError(boost::system::errc::invalid_argument);
+        return NetworkLayout {};
+    }
+    if (header.version != kSnapshotVersion ||
+        header.byteOrder != kByteOrderMark) {
+        ec = MakeError(boost::system::errc::not_supported);
+        return NetworkLayout {};
+    }
+    if (header.fileSize != size ||
+        (verify && header.checksum != Checksum(base + kChecksumStart,
+                                               size - kChecksumStart))) {
+        ec = MakeError(boost::system::errc::invalid_argument);
+        return NetworkLayout {};
+    }
+
+    NetworkLayout layout {};
+    SnapshotReader reader {base, header};
+    reader.Attach(StationIdChars, layout.stationIds_);
+    reader.Attach(StationNameChars, layout.stationNames_);
+    reader.Attach(LineIdChars, layout.lineIds_);
+    reader.Attach(LineNameChars, layout.lineNames_);
+    reader.Attach(RouteIdChars, layout.routeIds_);
+    reader.Attach(DirectionChars, layout.directions_);
+    layout.edgeOffsets_ = reader.Get<std::uint32_t>(EdgeOffsets);
+    layout.edges_ = reader.Get<Edge>(Edges);
+    layout.edgeSources_ = reader.Get<StationIndex>(EdgeSources);
+    layout.routes_ = reader.Get<Route>(Routes);
+    layout.routeStops_ = reader.Get<StationIndex>(RouteStops);
+    layout.lineRouteOffsets_ = reader.Get<std::uint32_t>(LineRouteOffsets);
+    layout.lineRoutes_ = reader.Get<RouteIndex>(LineRoutes);
+    layout.stationRouteOffsets_ = reader.Get<std::uint32_t>(
+        StationRouteOffsets
+    );
+    layout.stationRoutes_ = reader.Get<RouteIndex>(StationRoutes);
+
+    // Consistency checks, linear in the size of the arrays, so that a
+    // well-formed but mismatched file cannot send the accessors out of
+    // bounds. The checksum does not replace them: it is optional, and a
+    // file can match its checksum and still be inconsistent. The string
+    // tables were checked by Attach().
+    const auto nStations {layout.stationIds_.GetSize()};
+    const auto nLines {layout.lineIds_.GetSize()};
+    const auto nRoutes {layout.routeIds_.GetSize()};
+    const bool consistent {
+        reader.IsValid() &&
+        layout.stationNames_.GetSize() == nStations &&
+        layout.lineNames_.GetSize() == nLines &&
+        layout.routes_.size() == nRoutes &&
+        layout.edgeSources_.size() == layout.edges_.size() &&
+        IsCsr(layout.edgeOffsets_, nStations, layout.edges_) &&
+        IsCsr(layout.lineRouteOffsets_, nLines, layout.lineRoutes_) &&
+        IsCsr(layout.stationRouteOffsets_, nStations, layout.stationRoutes_) &&
+        AreEdgesValid(layout.edges_, nStations, nLines, nRoutes) &&
+        AreRoutesValid(layout.routes_, nStations, nLines,
+                       layout.directions_.GetSize(),
+                       layout.routeStops_.size()) &&
+        AllBelow(layout.edgeSources_, nStations) &&
+        AllBelow(layout.routeStops_, nStations) &&
+        AllBelow(layout.lineRoutes_, nRoutes) &&
+        AllBelow(layout.stationRoutes_, nRoutes)
+    };
+    if (!consistent) {
+        ec = MakeError(boost::system::errc::invalid_argument);
+        return NetworkLayout {};
+    }
+    layout.mapping_ = std::move(region);
+    return layout;
+}
+
+void NetworkLayout::WriteSnapshot(
+    const std::string& path,
+    boost::system::error_code& ec
+) const
+{
+    SnapshotWriter writer {};
+    writer.Add(StationIdChars, stationIds_);
+    writer.Add(StationNameChars, stationNames_);
+    writer.Add(LineIdChars, lineIds_);
+    writer.Add(LineNameChars, lineNames_);
+    writer.Add(RouteIdChars, routeIds_);
+    writer.Add(DirectionChars, directions_);
+    writer.Add(EdgeOffsets, edgeOffsets_);
+    writer.Add(Edges, edges_);
+    writer.Add(EdgeSources, edgeSources_);
+    writer.Add(Routes, routes_);
+    writer.Add(RouteStops, routeStops_);
+    writer.Add(LineRouteOffsets, lineRouteOffsets_);
+    writer.Add(LineRoutes, lineRoutes_);
+    writer.Add(StationRouteOffsets, stationRouteOffsets_);
+    writer.Add(StationRoutes, stationRoutes_);
+    const auto& image {writer.Finish()};
+
+    const auto staging {path + ".tmp"};
+    {
+        std::ofstream file {staging, std::ios::binary | std::ios::trunc};
+        file.write(image.data(), static_cast<std::streamsize>(image.size()));
+        file.close();
+        if (!file) {
+            boost::system::error_code ignored {};
+            boost::filesystem::remove(staging, ignored);
+            ec = MakeError(boost::system::errc::io_error);
+            return;
+        }
+    }
+    // Unlike std::rename, this replaces an existing snapshot on Windows too.
+    boost::filesystem::rename(staging, path, ec);
+    if (ec) {
+        boost::system::error_code ignored {};
+        boost::filesystem::remove(staging, ignored);
+        return;
+    }
+}
+
+} // namespace NetworkMonitor
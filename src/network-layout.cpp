@@ -0,0 +1,518 @@
+#include "network-layout.h"
+
+#include "csr.h"
+
+#include <boost/json.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+namespace NetworkMonitor {
+
+namespace {
+
+std::uint32_t Hash(boost::beast::string_view str)
+{
+    // FNV-1a. Our ids are short, so this is as fast as anything fancier.
+    std::uint32_t hash {2166136261u};
+    for (const auto c: str) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+boost::beast::string_view ToStringView(const boost::json::string& str)
+{
+    return {str.data(), str.size()};
+}
+
+boost::beast::string_view GetString(
+    const boost::json::value& obj,
+    boost::beast::string_view key
+)
+{
+    return ToStringView(obj.as_object().at(
+        boost::json::string_view {key.data(), key.size()}
+    ).as_string());
+}
+
+// Thrown while building the layout when the JSON is well-formed but does not
+// describe a valid network. Never leaves this file.
+struct InvalidLayout: std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+std::uint64_t PairKey(StationIndex a, StationIndex b)
+{
+    // Travel times are given once per pair of adjacent stations and apply in
+    // both directions.
+    if (a > b) {
+        std::swap(a, b);
+    }
+    return (static_cast<std::uint64_t>(a) << 32) | b;
+}
+
+struct TravelTime {
+    LineIndex line;
+    RouteIndex route;
+    std::uint32_t time;
+};
+
+} // namespace
+
+// StringTable
+
+StringTable::StringTable()
+{
+    Sync();
+}
+
+std::uint32_t StringTable::Intern(boost::beast::string_view str)
+{
+    const auto existing {Find(str)};
+    if (existing != kInvalidIndex) {
+        return existing;
+    }
+    const auto idx {Append(str)};
+    if (2 * GetSize() > ownedSlots_.size()) {
+        Grow();
+        return idx;
+    }
+    auto slot {Hash(str) & (ownedSlots_.size() - 1)};
+    while (ownedSlots_[slot] != kInvalidIndex) {
+        slot = (slot + 1) & (ownedSlots_.size() - 1);
+    }
+    ownedSlots_[slot] = idx;
+    return idx;
+}
+
+std::uint32_t StringTable::Append(boost::beast::string_view str)
+{
+    ownedChars_.insert(ownedChars_.end(), str.begin(), str.end());
+    ownedOffsets_.push_back(static_cast<std::uint32_t>(ownedChars_.size()));
+    Sync();
+    return static_cast<std::uint32_t>(ownedOffsets_.size() - 2);
+}
+
+std::uint32_t StringTable::Find(boost::beast::string_view str) const
+{
+    if (slots_.empty()) {
+        return kInvalidIndex;
+    }
+    auto slot {Hash(str) & (slots_.size() - 1)};
+    while (slots_[slot] != kInvalidIndex) {
+        if (Get(slots_[slot]) == str) {
+            return slots_[slot];
+        }
+        slot = (slot + 1) & (slots_.size() - 1);
+    }
+    return kInvalidIndex;
+}
+
+boost::beast::string_view StringTable::Get(std::uint32_t idx) const
+{
+    return {chars_.data() + offsets_[idx], offsets_[idx + 1] - offsets_[idx]};
+}
+
+std::size_t StringTable::GetSize() const
+{
+    return offsets_.size() - 1;
+}
+
+void StringTable::Attach(
+    Span<char> chars,
+    Span<std::uint32_t> offsets,
+    Span<std::uint32_t> slots
+)
+{
+    ownedChars_ = {};
+    ownedOffsets_ = {};
+    ownedSlots_ = {};
+    chars_ = chars;
+    offsets_ = offsets;
+    slots_ = slots;
+}
+
+Span<char> StringTable::GetChars() const
+{
+    return chars_;
+}
+
+Span<std::uint32_t> StringTable::GetOffsets() const
+{
+    return offsets_;
+}
+
+Span<std::uint32_t> StringTable::GetSlots() const
+{
+    return slots_;
+}
+
+void StringTable::Grow()
+{
+    // Keep the load factor at or below 1/2 so that probe chains stay short.
+    std::size_t nSlots {16};
+    while (nSlots < 4 * GetSize()) {
+        nSlots *= 2;
+    }
+    ownedSlots_.assign(nSlots, kInvalidIndex);
+    for (std::uint32_t idx {0}; idx < GetSize(); ++idx) {
+        auto slot {Hash(Get(idx)) & (ownedSlots_.size() - 1)};
+        while (ownedSlots_[slot] != kInvalidIndex) {
+            slot = (slot + 1) & (ownedSlots_.size() - 1);
+        }
+        ownedSlots_[slot] = idx;
+    }
+    Sync();
+}
+
+void StringTable::Sync()
+{
+    chars_ = {ownedChars_.data(), ownedChars_.size()};
+    offsets_ = {ownedOffsets_.data(), ownedOffsets_.size()};
+    slots_ = {ownedSlots_.data(), ownedSlots_.size()};
+}
+
+// NetworkLayout
+
+NetworkLayout NetworkLayout::FromJson(
+    boost::beast::string_view json,
+    boost::system::error_code& ec
+)
+{
+    NetworkLayout layout {};
+    const auto doc {boost::json::parse(
+        boost::json::string_view {json.data(), json.size()}, ec
+    )};
+    if (ec) {
+        return layout;
+    }
+
+    auto& owned {layout.owned_};
+    const auto getRouteStops = [&owned](RouteIndex route) {
+        const auto& info {owned.routes[route]};
+        return Span<StationIndex> {
+            owned.routeStops.data() + info.firstStop, info.stopCount
+        };
+    };
+    try {
+        // Stations
+        const auto& root {doc.as_object()};
+        for (const auto& station: root.at("stations").as_array()) {
+            const auto id {GetString(station, "station_id")};
+            if (layout.stationIds_.Find(id) != kInvalidIndex) {
+                throw InvalidLayout {"Duplicate station id"};
+            }
+            layout.stationIds_.Intern(id);
+            layout.stationNames_.Append(GetString(station, "name"));
+        }
+        const auto findStation = [&layout](boost::beast::string_view id) {
+            const auto station {layout.stationIds_.Find(id)};
+            if (station == kInvalidIndex) {
+                throw InvalidLayout {"Unknown station id"};
+            }
+            return station;
+        };
+
+        // Lines and routes. Routes are numbered line by line, so the routes of
+        // a line are contiguous.
+        owned.lineRouteOffsets.push_back(0);
+        for (const auto& lineJson: root.at("lines").as_array()) {
+            const auto lineId {GetString(lineJson, "line_id")};
+            if (layout.lineIds_.Find(lineId) != kInvalidIndex) {
+                throw InvalidLayout {"Duplicate line id"};
+            }
+            const auto line {layout.lineIds_.Intern(lineId)};
+            layout.lineNames_.Append(GetString(lineJson, "name"));
+
+            const auto& routesJson {lineJson.as_object().at("routes")};
+            for (const auto& routeJson: routesJson.as_array()) {
+                const auto routeId {GetString(routeJson, "route_id")};
+                if (layout.routeIds_.Find(routeId) != kInvalidIndex) {
+                    throw InvalidLayout {"Duplicate route id"};
+                }
+                const auto route {layout.routeIds_.Intern(routeId)};
+                owned.lineRoutes.push_back(route);
+
+                Route info {};
+                info.line = line;
+                info.start = findStation(
+                    GetString(routeJson, "start_station_id")
+                );
+                info.end = findStation(GetString(routeJson, "end_station_id"));
+                info.direction = layout.directions_.Intern(
+                    GetString(routeJson, "direction")
+                );
+                info.firstStop = static_cast<std::uint32_t>(
+                    owned.routeStops.size()
+                );
+                const auto& stopsJson {routeJson.as_object().at("route_stops")};
+                for (const auto& stop: stopsJson.as_array()) {
+                    owned.routeStops.push_back(
+                        findStation(ToStringView(stop.as_string()))
+                    );
+                }
+                info.stopCount = static_cast<std::uint32_t>(
+                    owned.routeStops.size() - info.firstStop
+                );
+                owned.routes.push_back(info);
+            }
+            owned.lineRouteOffsets.push_back(
+                static_cast<std::uint32_t>(owned.lineRoutes.size())
+            );
+        }
+
+        // Travel times, keyed by the unordered station pair.
+        std::unordered_map<std::uint64_t, std::vector<TravelTime>> times {};
+        for (const auto& travelTime: root.at("travel_times").as_array()) {
+            const auto from {
+                findStation(GetString(travelTime, "start_station_id"))
+            };
+            const auto to {
+                findStation(GetString(travelTime, "end_station_id"))
+            };
+            const auto& fields {travelTime.as_object()};
+            TravelTime entry {kInvalidIndex, kInvalidIndex, 0};
+            if (const auto line {fields.if_contains("line_id")}) {
+                entry.line = layout.lineIds_.Find(
+                    ToStringView(line->as_string())
+                );
+            }
+            if (const auto route {fields.if_contains("route_id")}) {
+                entry.route = layout.routeIds_.Find(
+                    ToStringView(route->as_string())
+                );
+            }
+            entry.time = fields.at("travel_time").to_number<std::uint32_t>();
+            times[PairKey(from, to)].push_back(entry);
+        }
+
+        // Edges: one per pair of consecutive stops on each route. When a pair
+        // has several travel times we prefer the one given for the same route,
+        // then the one for the same line.
+        std::vector<std::pair<std::uint32_t, Edge>> edges {};
+        for (RouteIndex route {0}; route < owned.routes.size(); ++route) {
+            const auto& info {owned.routes[route]};
+            const auto stops {getRouteStops(route)};
+            for (std::size_t idx {1}; idx < stops.size(); ++idx) {
+                const auto from {stops[idx - 1]};
+                const auto to {stops[idx]};
+                const auto found {times.find(PairKey(from, to))};
+                if (found == times.end()) {
+                    throw InvalidLayout {"Missing travel time"};
+                }
+                const auto& candidates {found->second};
+                auto best {candidates.begin()};
+                for (auto it {best}; it != candidates.end(); ++it) {
+                    if (it->route == route) {
+                        best = it;
+                        break;
+                    }
+                    if (it->line == info.line && best->line != info.line) {
+                        best = it;
+                    }
+                }
+                edges.push_back(
+                    {from, Edge {to, info.line, route, best->time}}
+                );
+            }
+        }
+        const auto nStations {layout.stationIds_.GetSize()};
+        BuildCsr(nStations, edges, owned.edgeOffsets, owned.edges);
+        owned.edgeSources.resize(owned.edges.size());
+        for (StationIndex station {0}; station < nStations; ++station) {
+            std::fill(
+                owned.edgeSources.begin() + owned.edgeOffsets[station],
+                owned.edgeSources.begin() + owned.edgeOffsets[station + 1],
+                station
+            );
+        }
+
+        // Routes serving each station.
+        std::vector<std::pair<std::uint32_t, RouteIndex>> stationRoutes {};
+        for (RouteIndex route {0}; route < owned.routes.size(); ++route) {
+            auto stops {getRouteStops(route)};
+            std::vector<StationIndex> unique(stops.begin(), stops.end());
+            std::sort(unique.begin(), unique.end());
+            unique.erase(std::unique(unique.begin(), unique.end()),
+                         unique.end());
+            for (const auto station: unique) {
+                stationRoutes.push_back({station, route});
+            }
+        }
+        BuildCsr(nStations, stationRoutes, owned.stationRouteOffsets,
+                 owned.stationRoutes);
+        layout.BindOwned();
+    } catch (const std::exception&) {
+        // Missing keys and values of the wrong type end up here as well.
+        ec = boost::system::errc::make_error_code(
+            boost::system::errc::invalid_argument
+        );
+        return NetworkLayout {};
+    }
+
+    return layout;
+}
+
+NetworkLayout NetworkLayout::FromFile(
+    const std::string& path,
+    boost::system::error_code& ec
+)
+{
+    std::ifstream file {path, std::ios::binary};
+    if (!file) {
+        ec = boost::system::errc::make_error_code(
+            boost::system::errc::no_such_file_or_directory
+        );
+        return NetworkLayout {};
+    }
+    std::stringstream contents {};
+    contents << file.rdbuf();
+    return FromJson(contents.str(), ec);
+}
+
+void NetworkLayout::BindOwned()
+{
+    const auto view = [](const auto& values) {
+        using T = typename std::decay_t<decltype(values)>::value_type;
+        return Span<T> {values.data(), values.size()};
+    };
+    edgeOffsets_ = view(owned_.edgeOffsets);
+    edges_ = view(owned_.edges);
+    edgeSources_ = view(owned_.edgeSources);
+    routes_ = view(owned_.routes);
+    routeStops_ = view(owned_.routeStops);
+    lineRouteOffsets_ = view(owned_.lineRouteOffsets);
+    lineRoutes_ = view(owned_.lineRoutes);
+    stationRouteOffsets_ = view(owned_.stationRouteOffsets);
+    stationRoutes_ = view(owned_.stationRoutes);
+}
+
+std::size_t NetworkLayout::GetStationCount() const
+{
+    return stationIds_.GetSize();
+}
+
+std::size_t NetworkLayout::GetLineCount() const
+{
+    return lineIds_.GetSize();
+}
+
+std::size_t NetworkLayout::GetRouteCount() const
+{
+    return routes_.size();
+}
+
+std::size_t NetworkLayout::GetEdgeCount() const
+{
+    return edges_.size();
+}
+
+StationIndex NetworkLayout::FindStation(boost::beast::string_view id) const
+{
+    return stationIds_.Find(id);
+}
+
+LineIndex NetworkLayout::FindLine(boost::beast::string_view id) const
+{
+    return lineIds_.Find(id);
+}
+
+RouteIndex NetworkLayout::FindRoute(boost::beast::string_view id) const
+{
+    return routeIds_.Find(id);
+}
+
+boost::beast::string_view NetworkLayout::GetStationId(
+    StationIndex station
+) const
+{
+    return stationIds_.Get(station);
+}
+
+boost::beast::string_view NetworkLayout::GetStationName(
+    StationIndex station
+) const
+{
+    return stationNames_.Get(station);
+}
+
+boost::beast::string_view NetworkLayout::GetLineId(LineIndex line) const
+{
+    return lineIds_.Get(line);
+}
+
+boost::beast::string_view NetworkLayout::GetLineName(LineIndex line) const
+{
+    return lineNames_.Get(line);
+}
+
+boost::beast::string_view NetworkLayout::GetRouteId(RouteIndex route) const
+{
+    return routeIds_.Get(route);
+}
+
+boost::beast::string_view NetworkLayout::GetRouteDirection(
+    RouteIndex route
+) const
+{
+    return directions_.Get(routes_[route].direction);
+}
+
+Span<Edge> NetworkLayout::GetEdges(StationIndex station) const
+{
+    return {
+        edges_.data() + edgeOffsets_[station],
+        edgeOffsets_[station + 1] - edgeOffsets_[station]
+    };
+}
+
+Span<Edge> NetworkLayout::GetAllEdges() const
+{
+    return {edges_.data(), edges_.size()};
+}
+
+EdgeIndex NetworkLayout::GetEdgeIndex(const Edge& edge) const
+{
+    return static_cast<EdgeIndex>(&edge - edges_.data());
+}
+
+StationIndex NetworkLayout::GetEdgeSource(EdgeIndex edge) const
+{
+    return edgeSources_[edge];
+}
+
+const Route& NetworkLayout::GetRoute(RouteIndex route) const
+{
+    return routes_[route];
+}
+
+Span<StationIndex> NetworkLayout::GetRouteStops(RouteIndex route) const
+{
+    const auto& info {routes_[route]};
+    return {routeStops_.data() + info.firstStop, info.stopCount};
+}
+
+Span<RouteIndex> NetworkLayout::GetLineRoutes(LineIndex line) const
+{
+    return {
+        lineRoutes_.data() + lineRouteOffsets_[line],
+        lineRouteOffsets_[line + 1] - lineRouteOffsets_[line]
+    };
+}
+
+Span<RouteIndex> NetworkLayout::GetStationRoutes(StationIndex station) const
+{
+    return {
+        stationRoutes_.data() + stationRouteOffsets_[station],
+        stationRouteOffsets_[station + 1] - stationRouteOffsets_[station]
+    };
+}
+
+} // namespace NetworkMonitor
@@ -0,0 +1,312 @@
+#ifndef NETWORK_MONITOR_NETWORK_LAYOUT_H
+#define NETWORK_MONITOR_NETWORK_LAYOUT_H
+
+#include <boost/beast/core/string.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief Dense integer ids for the string ids found in the layout.
+ *
+ *  Stations, lines and routes are numbered from 0 in the order they appear in
+ *  the layout file, so they can be used directly as array indices.
+ */
+using StationIndex = std::uint32_t;
+using LineIndex = std::uint32_t;
+using RouteIndex = std::uint32_t;
+using EdgeIndex = std::uint32_t;
+
+/*! \brief Returned by the lookup functions when an id is unknown.
+ */
+constexpr std::uint32_t kInvalidIndex {0xFFFFFFFF};
+
+/*! \brief Read-only view over a contiguous array.
+ */
+template <typename T>
+class Span {
+public:
+    Span() = default;
+
+    Span(const T* data, std::size_t size)
+        : data_ {data},
+          size_ {size}
+    {
+    }
+
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    const T* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T& operator[](std::size_t idx) const { return data_[idx]; }
+
+private:
+    const T* data_ {nullptr};
+    std::size_t size_ {0};
+};
+
+/*! \brief Maps strings to dense integers and back.
+ *
+ *  All characters live in one contiguous block and the hash index is a flat
+ *  open-addressing table, so a lookup touches at most a couple of cache lines
+ *  and there is no per-string allocation.
+ *
+ *  The three arrays can also live outside the table, in a mapped layout
+ *  snapshot: see Attach().
+ */
+class StringTable {
+public:
+    StringTable();
+
+    // Moving keeps the vector buffers, so the views stay valid. A copy would
+    // need fresh views, and is never needed.
+    StringTable(StringTable&&) = default;
+    StringTable& operator=(StringTable&&) = default;
+    StringTable(const StringTable&) = delete;
+    StringTable& operator=(const StringTable&) = delete;
+
+    /*! \brief Add a string, or return its index if it is already present.
+     */
+    std::uint32_t Intern(boost::beast::string_view str);
+
+    /*! \brief Add a string without deduplicating it. Use for payloads such as
+     *         display names that are only ever looked up by index.
+     */
+    std::uint32_t Append(boost::beast::string_view str);
+
+    /*! \brief Find the index of an interned string.
+     *
+     *  \returns kInvalidIndex if the string was never interned.
+     */
+    std::uint32_t Find(boost::beast::string_view str) const;
+
+    /*! \brief Get the string stored at an index.
+     */
+    boost::beast::string_view Get(std::uint32_t idx) const;
+
+    /*! \brief Number of strings stored.
+     */
+    std::size_t GetSize() const;
+
+    /*! \brief Use arrays owned by someone else instead of our own.
+     *
+     *  The arrays must have been obtained from GetChars(), GetOffsets() and
+     *  GetSlots() of a table, and must outlive this one. The table must not
+     *  be modified afterwards.
+     */
+    void Attach(
+        Span<char> chars,
+        Span<std::uint32_t> offsets,
+        Span<std::uint32_t> slots
+    );
+
+    Span<char> GetChars() const;
+    Span<std::uint32_t> GetOffsets() const;
+    Span<std::uint32_t> GetSlots() const;
+
+private:
+    std::vector<char> ownedChars_ {};
+    std::vector<std::uint32_t> ownedOffsets_ {0};
+    std::vector<std::uint32_t> ownedSlots_ {};
+
+    // What the lookups read: the vectors above, or attached arrays.
+    Span<char> chars_ {};
+    Span<std::uint32_t> offsets_ {};
+    Span<std::uint32_t> slots_ {};
+
+    void Grow();
+    void Sync();
+};
+
+/*! \brief A directed hop between two consecutive stops of a route.
+ */
+struct Edge {
+    StationIndex to;
+    LineIndex line;
+    RouteIndex route;
+    std::uint32_t travelTime;
+};
+
+/*! \brief A route: an ordered list of stops served by one line in one
+ *         direction.
+ */
+struct Route {
+    LineIndex line;
+    StationIndex start;
+    StationIndex end;
+    std::uint32_t firstStop; // Offset into the route stops array.
+    std::uint32_t stopCount;
+    std::uint32_t direction; // Interned in the direction table.
+};
+
+/*! \brief In-memory transport network, built from network-layout.json.
+ *
+ *  The layout is stored as a handful of flat arrays:
+ *  - the outgoing edges of all stations, in CSR form: the edges leaving
+ *    station s are edges_[edgeOffsets_[s]] to edges_[edgeOffsets_[s + 1]];
+ *  - the stops of all routes, back to back;
+ *  - the routes of all lines and the routes serving each station, in CSR form.
+ *
+ *  All lookups by index are O(1) array accesses. Lookups by string id go
+ *  through a StringTable and are O(1) on average.
+ *
+ *  The arrays are either built from the JSON file and owned by the layout, or
+ *  used in place from a memory-mapped binary snapshot written by
+ *  WriteSnapshot(), which makes loading a matter of checking a header.
+ */
+class NetworkLayout {
+public:
+    NetworkLayout() = default;
+
+    // Moving keeps the vector buffers and the mapping, so the views stay
+    // valid. Layouts are large and never need copying.
+    NetworkLayout(NetworkLayout&&) = default;
+    NetworkLayout& operator=(NetworkLayout&&) = default;
+    NetworkLayout(const NetworkLayout&) = delete;
+    NetworkLayout& operator=(const NetworkLayout&) = delete;
+
+    /*! \brief Build the layout from the contents of a layout JSON file.
+     *
+     *  \param json The JSON document.
+     *  \param ec   Set to the parser error if the document is not valid JSON,
+     *              or to errc::invalid_argument if it does not describe a
+     *              valid network (e.g. it references an unknown station).
+     */
+    static NetworkLayout FromJson(
+        boost::beast::string_view json,
+        boost::system::error_code& ec
+    );
+
+    /*! \brief Build the layout from a layout JSON file on disk.
+     */
+    static NetworkLayout FromFile(
+        const std::string& path,
+        boost::system::error_code& ec
+    );
+
+    /*! \brief Map a snapshot written by WriteSnapshot() and use it in place.
+     *
+     *  Nothing is parsed or copied: the layout points into the mapped file,
+     *  which stays mapped for as long as the layout exists.
+     *
+     *  \param path   The snapshot file.
+     *  \param ec     Set to the system error if the file cannot be mapped,
+     *                to errc::not_supported if it was written by another
+     *                version or on a machine of another byte order, and to
+     *                errc::invalid_argument if it is truncated or corrupt.
+     *  \param verify Check the checksum of the whole file. This reads every
+     *                byte once; skip it to only touch the pages in use.
+     */
+    static NetworkLayout FromSnapshot(
+        const std::string& path,
+        boost::system::error_code& ec,
+        bool verify = true
+    );
+
+    /*! \brief Save the layout as a binary snapshot for FromSnapshot().
+     *
+     *  The file is written next to its destination and renamed into place,
+     *  so a monitor that starts meanwhile never maps a half-written file.
+     */
+    void WriteSnapshot(
+        const std::string& path,
+        boost::system::error_code& ec
+    ) const;
+
+    std::size_t GetStationCount() const;
+    std::size_t GetLineCount() const;
+    std::size_t GetRouteCount() const;
+    std::size_t GetEdgeCount() const;
+
+    /*! \brief Find a station, line or route by its string id.
+     *
+     *  \returns kInvalidIndex if the id is unknown.
+     */
+    StationIndex FindStation(boost::beast::string_view id) const;
+    LineIndex FindLine(boost::beast::string_view id) const;
+    RouteIndex FindRoute(boost::beast::string_view id) const;
+
+    boost::beast::string_view GetStationId(StationIndex station) const;
+    boost::beast::string_view GetStationName(StationIndex station) const;
+    boost::beast::string_view GetLineId(LineIndex line) const;
+    boost::beast::string_view GetLineName(LineIndex line) const;
+    boost::beast::string_view GetRouteId(RouteIndex route) const;
+    boost::beast::string_view GetRouteDirection(RouteIndex route) const;
+
+    /*! \brief Outgoing edges of a station.
+     */
+    Span<Edge> GetEdges(StationIndex station) const;
+
+    /*! \brief All the edges, ordered by source station.
+     */
+    Span<Edge> GetAllEdges() const;
+
+    /*! \brief Index of an edge returned by GetEdges() or GetAllEdges().
+     */
+    EdgeIndex GetEdgeIndex(const Edge& edge) const;
+
+    /*! \brief Source station of an edge.
+     */
+    StationIndex GetEdgeSource(EdgeIndex edge) const;
+
+    const Route& GetRoute(RouteIndex route) const;
+    Span<StationIndex> GetRouteStops(RouteIndex route) const;
+
+    /*! \brief Routes that belong to a line.
+     */
+    Span<RouteIndex> GetLineRoutes(LineIndex line) const;
+
+    /*! \brief Routes that stop at a station.
+     */
+    Span<RouteIndex> GetStationRoutes(StationIndex station) const;
+
+private:
+    StringTable stationIds_ {};
+    StringTable stationNames_ {};
+    StringTable lineIds_ {};
+    StringTable lineNames_ {};
+    StringTable routeIds_ {};
+    StringTable directions_ {};
+
+    Span<std::uint32_t> edgeOffsets_ {};
+    Span<Edge> edges_ {};
+    Span<StationIndex> edgeSources_ {};
+
+    Span<Route> routes_ {};
+    Span<StationIndex> routeStops_ {};
+
+    Span<std::uint32_t> lineRouteOffsets_ {};
+    Span<RouteIndex> lineRoutes_ {};
+
+    Span<std::uint32_t> stationRouteOffsets_ {};
+    Span<RouteIndex> stationRoutes_ {};
+
+    // Backing storage of the arrays above, for a layout built from JSON.
+    struct OwnedArrays {
+        std::vector<std::uint32_t> edgeOffsets {};
+        std::vector<Edge> edges {};
+        std::vector<StationIndex> edgeSources {};
+        std::vector<Route> routes {};
+        std::vector<StationIndex> routeStops {};
+        std::vector<std::uint32_t> lineRouteOffsets {};
+        std::vector<RouteIndex> lineRoutes {};
+        std::vector<std::uint32_t> stationRouteOffsets {};
+        std::vector<RouteIndex> stationRoutes {};
+    };
+    OwnedArrays owned_ {};
+
+    // For a layout loaded from a snapshot: the mapped file.
+    std::shared_ptr<const void> mapping_ {};
+
+    void BindOwned();
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_NETWORK_LAYOUT_H
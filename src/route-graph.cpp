@@ -0,0 +1,61 @@
+#include "route-graph.h"
+
+#include "csr.h"
+
+#include <utility>
+
+namespace NetworkMonitor {
+
+RouteGraph RouteGraph::Build(
+    const NetworkLayout& layout,
+    std::uint32_t changePenalty
+)
+{
+    const auto nStations {static_cast<std::uint32_t>(
+        layout.GetStationCount()
+    )};
+    std::uint32_t nStops {0};
+    std::vector<std::pair<std::uint32_t, Arc>> arcs {};
+    for (RouteIndex route {0}; route < layout.GetRouteCount(); ++route) {
+        const auto& info {layout.GetRoute(route)};
+        const auto stops {layout.GetRouteStops(route)};
+        nStops += info.stopCount;
+        for (std::uint32_t k {0}; k < stops.size(); ++k) {
+            const auto node {nStations + info.firstStop + k};
+            const auto station {stops[k]};
+            if (k > 0) {
+                arcs.push_back({node, Arc {station, 0, kInvalidIndex}});
+            }
+            if (k + 1 == stops.size()) {
+                continue;
+            }
+            arcs.push_back({station, Arc {
+                node, changePenalty, kInvalidIndex
+            }});
+            for (const auto& edge: layout.GetEdges(station)) {
+                if (edge.route == route && edge.to == stops[k + 1]) {
+                    arcs.push_back({node, Arc {
+                        node + 1, edge.travelTime, layout.GetEdgeIndex(edge)
+                    }});
+                    break;
+                }
+            }
+        }
+    }
+
+    RouteGraph graph {};
+    graph.nNodes = nStations + nStops;
+    std::vector<std::pair<std::uint32_t, Arc>> reverseArcs {};
+    reverseArcs.reserve(arcs.size());
+    for (const auto& entry: arcs) {
+        reverseArcs.push_back({entry.second.to, Arc {
+            entry.first, entry.second.weight, entry.second.edge
+        }});
+    }
+    BuildCsr(graph.nNodes, arcs, graph.arcOffsets, graph.arcs);
+    BuildCsr(graph.nNodes, reverseArcs, graph.reverseArcOffsets,
+             graph.reverseArcs);
+    return graph;
+}
+
+} // namespace NetworkMonitor
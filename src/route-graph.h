@@ -0,0 +1,54 @@
+#ifndef NETWORK_MONITOR_ROUTE_GRAPH_H
+#define NETWORK_MONITOR_ROUTE_GRAPH_H
+
+#include "network-layout.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief The expanded graph that the route planners search.
+ *
+ *  It has one node per station and one node per route stop. Riding a route
+ *  moves between consecutive route stop nodes; boarding a route costs the
+ *  change penalty and alighting is free.
+ *
+ *  Nodes [0, nStations) are the stations, so a station index is also its
+ *  node index. The route stop at position k of route r is node
+ *  nStations + firstStop(r) + k.
+ */
+struct RouteGraph {
+    /*! \brief An arc of the graph. Ride arcs carry the layout edge they stand
+     *         for; boarding and alighting arcs carry kInvalidIndex.
+     */
+    struct Arc {
+        std::uint32_t to;
+        std::uint32_t weight;
+        EdgeIndex edge;
+    };
+
+    std::uint32_t nNodes {0};
+
+    /*! \brief Outgoing arcs in CSR form.
+     */
+    std::vector<std::uint32_t> arcOffsets {};
+    std::vector<Arc> arcs {};
+
+    /*! \brief Incoming arcs in CSR form. Their `to` is the source of the
+     *         arc.
+     */
+    std::vector<std::uint32_t> reverseArcOffsets {};
+    std::vector<Arc> reverseArcs {};
+
+    /*! \brief Build the graph of a layout.
+     */
+    static RouteGraph Build(
+        const NetworkLayout& layout,
+        std::uint32_t changePenalty
+    );
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_ROUTE_GRAPH_H
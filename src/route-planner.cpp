@@ -0,0 +1,325 @@
+#include "route-planner.h"
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <numeric>
+#include <queue>
+#include <utility>
+
+namespace NetworkMonitor {
+
+namespace {
+
+// Batch queries are handed to the pool in chunks of this many queries, to
+// keep the cost of posting small compared to the work.
+constexpr std::size_t kBatchChunk {256};
+
+using QueueEntry = std::pair<std::uint32_t, std::uint32_t>; // distance, node
+using MinQueue = std::priority_queue<
+    QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>
+>;
+
+} // namespace
+
+RoutePlanner::RoutePlanner(
+    const NetworkLayout& layout,
+    RoutePlannerOptions options
+) : layout_ {layout},
+    options_ {options},
+    graph_ {RouteGraph::Build(layout, options.changePenalty)}
+{
+    BuildLabels();
+}
+
+std::uint32_t RoutePlanner::GetQuickestCost(
+    StationIndex from,
+    StationIndex to
+) const
+{
+    return ToCost(from, to, GetDistance(from, to));
+}
+
+bool RoutePlanner::GetQuickestRoute(
+    StationIndex from,
+    StationIndex to,
+    Itinerary& itinerary
+) const
+{
+    const auto total {GetDistance(from, to)};
+    if (total == kUnreachable) {
+        return false;
+    }
+
+    Itinerary result {};
+    result.cost = ToCost(from, to, total);
+
+    // Walk the shortest path one arc at a time: from each node we take any
+    // arc that keeps us on a shortest path to the target. Station nodes have
+    // the same index as the station.
+    std::uint32_t node {from};
+    std::uint32_t previous {kInvalidIndex};
+    std::uint32_t remaining {total};
+    std::uint32_t boardings {0};
+    for (std::uint32_t step {0}; node != to && step < graph_.nNodes; ++step) {
+        const RouteGraph::Arc* next {nullptr};
+        for (auto idx {graph_.arcOffsets[node]};
+             idx < graph_.arcOffsets[node + 1]; ++idx) {
+            const auto& arc {graph_.arcs[idx]};
+            // With a zero change penalty a station and its route stops are
+            // zero-cost apart. Never step straight back.
+            if (arc.to == previous || arc.weight > remaining) {
+                continue;
+            }
+            const auto distance {GetDistance(arc.to, to)};
+            if (distance != kUnreachable &&
+                arc.weight + distance == remaining) {
+                next = &arc;
+                break;
+            }
+        }
+        if (next == nullptr) {
+            return false;
+        }
+        if (next->edge != kInvalidIndex) {
+            result.edges.push_back(next->edge);
+            result.travelTime += next->weight;
+        } else if (node < layout_.GetStationCount()) {
+            ++boardings;
+        }
+        remaining -= next->weight;
+        previous = node;
+        node = next->to;
+    }
+    if (node != to) {
+        return false;
+    }
+    result.changes = boardings > 0 ? boardings - 1 : 0;
+    itinerary = std::move(result);
+    return true;
+}
+
+void RoutePlanner::GetQuickestCosts(
+    const std::vector<RouteQuery>& queries,
+    std::vector<std::uint32_t>& costs,
+    boost::asio::thread_pool& pool
+) const
+{
+    costs.resize(queries.size());
+    if (queries.empty()) {
+        return;
+    }
+
+    const auto nChunks {(queries.size() + kBatchChunk - 1) / kBatchChunk};
+    std::atomic<std::size_t> pending {nChunks};
+    std::promise<void> done {};
+    for (std::size_t chunk {0}; chunk < nChunks; ++chunk) {
+        boost::asio::post(pool, [&, chunk]() {
+            const auto begin {chunk * kBatchChunk};
+            const auto end {std::min(begin + kBatchChunk, queries.size())};
+            for (auto idx {begin}; idx < end; ++idx) {
+                costs[idx] = GetQuickestCost(queries[idx].from,
+                                             queries[idx].to);
+            }
+            if (pending.fetch_sub(1) == 1) {
+                done.set_value();
+            }
+        });
+    }
+    done.get_future().wait();
+}
+
+std::uint32_t RoutePlanner::GetQuickestCostDijkstra(
+    StationIndex from,
+    StationIndex to
+) const
+{
+    std::vector<std::uint32_t> distances(graph_.nNodes, kUnreachable);
+    MinQueue queue {};
+    distances[from] = 0;
+    queue.push({0, from});
+    while (!queue.empty()) {
+        const auto entry {queue.top()};
+        queue.pop();
+        const auto distance {entry.first};
+        const auto node {entry.second};
+        if (distance > distances[node]) {
+            continue;
+        }
+        if (node == to) {
+            return ToCost(from, to, distance);
+        }
+        for (auto idx {graph_.arcOffsets[node]};
+             idx < graph_.arcOffsets[node + 1]; ++idx) {
+            const auto& arc {graph_.arcs[idx]};
+            if (distance + arc.weight < distances[arc.to]) {
+                distances[arc.to] = distance + arc.weight;
+                queue.push({distances[arc.to], arc.to});
+            }
+        }
+    }
+    return kUnreachable;
+}
+
+std::size_t RoutePlanner::GetLabelCount() const
+{
+    return outLabels_.size() + inLabels_.size();
+}
+
+void RoutePlanner::BuildLabels()
+{
+    // Pruned landmark labelling. Nodes become hubs in order of decreasing
+    // degree: interchanges first, since most shortest paths go through them.
+    std::vector<std::uint32_t> order(graph_.nNodes);
+    std::iota(order.begin(), order.end(), 0);
+    const auto degree = [this](std::uint32_t node) {
+        return graph_.arcOffsets[node + 1] - graph_.arcOffsets[node] +
+               graph_.reverseArcOffsets[node + 1] -
+               graph_.reverseArcOffsets[node];
+    };
+    std::stable_sort(order.begin(), order.end(),
+        [&degree](std::uint32_t a, std::uint32_t b) {
+            return degree(a) > degree(b);
+        }
+    );
+
+    std::vector<std::vector<LabelEntry>> outLabels(graph_.nNodes);
+    std::vector<std::vector<LabelEntry>> inLabels(graph_.nNodes);
+    std::vector<std::uint32_t> rootLabel(graph_.nNodes, kUnreachable);
+    std::vector<std::uint32_t> distances(graph_.nNodes, kUnreachable);
+    std::vector<std::uint32_t> touched {};
+    MinQueue queue {};
+
+    // One pruned Dijkstra from the hub. rootLabels holds the labels of the
+    // hub on the side facing the search; labels the labels being built.
+    const auto search = [&](
+        std::uint32_t rank,
+        const std::vector<std::uint32_t>& offsets,
+        const std::vector<RouteGraph::Arc>& arcs,
+        const std::vector<LabelEntry>& rootLabels,
+        std::vector<std::vector<LabelEntry>>& labels
+    ) {
+        const auto hub {order[rank]};
+        for (const auto& entry: rootLabels) {
+            rootLabel[entry.hub] = entry.distance;
+        }
+        distances[hub] = 0;
+        touched.push_back(hub);
+        queue.push({0, hub});
+        while (!queue.empty()) {
+            const auto entry {queue.top()};
+            queue.pop();
+            const auto distance {entry.first};
+            const auto node {entry.second};
+            if (distance > distances[node]) {
+                continue;
+            }
+
+            // Prune when the hubs found so far already cover this pair.
+            bool covered {false};
+            for (const auto& label: labels[node]) {
+                if (rootLabel[label.hub] != kUnreachable &&
+                    rootLabel[label.hub] + label.distance <= distance) {
+                    covered = true;
+                    break;
+                }
+            }
+            if (covered) {
+                continue;
+            }
+            labels[node].push_back({rank, distance});
+
+            for (auto idx {offsets[node]}; idx < offsets[node + 1]; ++idx) {
+                const auto& arc {arcs[idx]};
+                if (distance + arc.weight < distances[arc.to]) {
+                    if (distances[arc.to] == kUnreachable) {
+                        touched.push_back(arc.to);
+                    }
+                    distances[arc.to] = distance + arc.weight;
+                    queue.push({distances[arc.to], arc.to});
+                }
+            }
+        }
+        for (const auto node: touched) {
+            distances[node] = kUnreachable;
+        }
+        touched.clear();
+        for (const auto& entry: rootLabels) {
+            rootLabel[entry.hub] = kUnreachable;
+        }
+    };
+
+    for (std::uint32_t rank {0}; rank < graph_.nNodes; ++rank) {
+        const auto hub {order[rank]};
+        // Forward: distances from the hub, stored in the in-labels. Copy the
+        // root labels: the search may append to the hub's own labels.
+        const auto hubOut {outLabels[hub]};
+        search(rank, graph_.arcOffsets, graph_.arcs, hubOut, inLabels);
+        // Backward: distances to the hub, stored in the out-labels.
+        const auto hubIn {inLabels[hub]};
+        search(rank, graph_.reverseArcOffsets, graph_.reverseArcs, hubIn,
+               outLabels);
+    }
+
+    const auto flatten = [](
+        const std::vector<std::vector<LabelEntry>>& labels,
+        std::vector<std::uint32_t>& offsets,
+        std::vector<LabelEntry>& flat
+    ) {
+        offsets.assign(1, 0);
+        flat.clear();
+        for (const auto& nodeLabels: labels) {
+            flat.insert(flat.end(), nodeLabels.begin(), nodeLabels.end());
+            offsets.push_back(static_cast<std::uint32_t>(flat.size()));
+        }
+    };
+    flatten(outLabels, outLabelOffsets_, outLabels_);
+    flatten(inLabels, inLabelOffsets_, inLabels_);
+}
+
+std::uint32_t RoutePlanner::GetDistance(
+    std::uint32_t from,
+    std::uint32_t to
+) const
+{
+    // Both lists are sorted by hub rank: merge them.
+    auto out {outLabels_.data() + outLabelOffsets_[from]};
+    const auto outEnd {outLabels_.data() + outLabelOffsets_[from + 1]};
+    auto in {inLabels_.data() + inLabelOffsets_[to]};
+    const auto inEnd {inLabels_.data() + inLabelOffsets_[to + 1]};
+    std::uint32_t best {kUnreachable};
+    while (out != outEnd && in != inEnd) {
+        if (out->hub < in->hub) {
+            ++out;
+        } else if (out->hub > in->hub) {
+            ++in;
+        } else {
+            best = std::min(best, out->distance + in->distance);
+            ++out;
+            ++in;
+        }
+    }
+    return best;
+}
+
+std::uint32_t RoutePlanner::ToCost(
+    StationIndex from,
+    StationIndex to,
+    std::uint32_t distance
+) const
+{
+    // Every path between two different stations boards once before any
+    // change, and that first boarding is not a change.
+    if (from == to) {
+        return 0;
+    }
+    if (distance == kUnreachable) {
+        return kUnreachable;
+    }
+    return distance - options_.changePenalty;
+}
+
+} // namespace NetworkMonitor
@@ -2,7 +2,9 @@
 #include <boost/system/error_code.hpp>
 #include <boost/beast/websocket.hpp> // Correct WebSocket header
 #include <boost/beast/core.hpp> // For flat_buffer and tcp_stream
+#include <algorithm>
 #include <string>
+#include "dns-cache.h"
 #include "websocket-client.h"
 
 
@@ -11,17 +13,57 @@ using tcp = boost::asio::ip::tcp;
 
 namespace NetworkMonitor 
 {
+    namespace {
+
+    // Counters have a single writer, the strand, so a load and a store do
+    // what a locked fetch_add would.
+    void Increment(std::atomic<std::uint64_t>& counter, std::uint64_t n = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n,
+                      std::memory_order_relaxed);
+    }
+
+    std::uint64_t NanosecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start
+            ).count()
+        );
+    }
+
+    } // namespace
+
+    constexpr std::size_t WebSocketClient::kDefaultHighWaterMark;
+    constexpr std::size_t WebSocketClient::kCoalesceMessageBytes;
+    constexpr std::size_t WebSocketClient::kCoalesceBatchBytes;
+
     WebSocketClient::WebSocketClient(
         const std::string& url,
         const std::string& endpoint,
         const std::string& port,
-        boost::asio::io_context& ioc
+        boost::asio::io_context& ioc,
+        WebSocketClientOptions options
     ) : url_ {url},
         endpoint_ {endpoint},
         port_ {port},
-        resolver_ {boost::asio::make_strand(ioc)},
-        ws_ {boost::asio::make_strand(ioc)}
+        options_ {std::move(options)},
+        ws_ {boost::asio::make_strand(ioc)},
+        resolver_ {ws_.get_executor()},
+        attemptTimer_ {ws_.get_executor()},
+        reconnectTimer_ {ws_.get_executor()},
+        rng_ {std::random_device {}()}
     {
+        // The TCP layer only bounds the connection attempts. Once connected,
+        // the WebSocket stream runs its own handshake timer.
+        boost::beast::websocket::stream_base::timeout timeouts {};
+        timeouts.handshake_timeout = options_.handshakeTimeout;
+        timeouts.idle_timeout = boost::beast::websocket::stream_base::none();
+        timeouts.keep_alive_pings = false;
+        ws_.set_option(timeouts);
+        ws_.set_option(MakePermessageDeflate(options_.compression,
+                                             boost::beast::role_type::client));
+        ws_.next_layer().SetCpuAccounting(options_.cpuStats);
     }
 
     WebSocketClient:: ~WebSocketClient() = default;
@@ -36,80 +78,319 @@ namespace NetworkMonitor
         OnConnect_   =std::move(on_connect);
         OnMessage_      =std::move(on_message);
         OnDisconnect_     =std::move(on_disconnect);
+        OnMessageView_ = nullptr;
+        pullMode_ = false;
 
-        // Step 1. Start the chain of asynchronous callbacks
-        resolver_.async_resolve(
-          url_,port_,
-          [this](auto err_code, auto endpoint)
-        {
-          std::cout << "About to call OnResolve" << std::endl;
-          OnResolve(err_code,endpoint); // private function
+        boost::asio::post(ws_.get_executor(), [this]() {
+            StartConnect();
         });
   }    
 
-  void WebSocketClient::OnResolve(const boost::system::error_code& ec,
-                                typename tcp::resolver::results_type results)
+  void WebSocketClient::ConnectView(
+    std::function<void (boost::system::error_code)> onConnect,
+    std::function<void (boost::system::error_code,
+                        boost::beast::string_view)> onMessage,
+    std::function<void (boost::system::error_code)> onDisconnect)
   {
-    std::cout << "Entered OnResolve" << std::endl;
-    if (ec) {
-        std::cout << "Error in OnResolve " << ec << std::endl;
-        if (OnConnect_) {
-            OnConnect_(ec);
+    // Same chain as Connect(), only the message callback differs.
+    OnConnect_ = std::move(onConnect);
+    OnMessage_ = nullptr;
+    OnMessageView_ = std::move(onMessage);
+    OnDisconnect_ = std::move(onDisconnect);
+    pullMode_ = false;
+
+    boost::asio::post(ws_.get_executor(), [this]() {
+        StartConnect();
+    });
+  }
+
+  void WebSocketClient::StartPullConnect(
+    std::function<void (boost::system::error_code)> onConnect)
+  {
+    // Same chain again, but nobody reads until AsyncRead() is called.
+    OnConnect_ = std::move(onConnect);
+    OnMessage_ = nullptr;
+    OnMessageView_ = nullptr;
+    OnDisconnect_ = nullptr;
+    pullMode_ = true;
+
+    boost::asio::post(ws_.get_executor(), [this]() {
+        StartConnect();
+    });
+  }
+
+  void WebSocketClient::StartConnect()
+  {
+    if (state_ == State::Connected) {
+        NM_LOG_WARNING("Connect() called on a connected client");
+        if (pullMode_ && OnConnect_) {
+            OnConnect_(boost::asio::error::already_connected);
         }
         return;
     }
+    state_ = State::Connecting;
+    ++cycle_;
+    phaseStart_ = std::chrono::steady_clock::now();
 
-          std::cout << "About to call async_connect" << std::endl;
-    // Step 2. Connect to the TCP socket
-    ws_.next_layer().async_connect(*results,
-        [this](auto ec) {
-            OnConnect(ec);
+    // Step 1. Find the server: from the cache if we can, so that a
+    // reconnection goes straight to the TCP handshake.
+    std::vector<tcp::endpoint> endpoints {};
+    if (options_.dnsTtl.count() > 0 &&
+        DnsCache::Get().Find(url_, port_, endpoints)) {
+        OnResolve({}, std::move(endpoints));
+        return;
+    }
+    resolver_.async_resolve(
+      url_,port_,
+      [this, cycle = cycle_](auto err_code, auto results)
+    {
+      if (cycle != cycle_) {
+          return;
+      }
+      NM_LOG_DEBUG("About to call OnResolve");
+      std::vector<tcp::endpoint> endpoints {};
+      for (const auto& result: results) {
+          endpoints.push_back(result.endpoint());
+      }
+      if (!err_code && options_.dnsTtl.count() > 0) {
+          DnsCache::Get().Store(url_, port_, endpoints, options_.dnsTtl);
+      }
+      OnResolve(err_code, std::move(endpoints)); // private function
+    });
+  }
+
+  void WebSocketClient::OnResolve(const boost::system::error_code& ec,
+                                  std::vector<tcp::endpoint> endpoints)
+  {
+    NM_LOG_DEBUG("Entered OnResolve");
+    if (ec || endpoints.empty()) {
+        NM_LOG_ERROR("Error in OnResolve", ec);
+        OnConnectFailed(ec ? ec : boost::asio::error::host_not_found);
+        return;
+    }
+
+    EndPhase(resolveTime_);
+
+    // Step 2. Race TCP connections across the addresses, alternating
+    // between address families as RFC 8305 suggests.
+    endpoints_.clear();
+    std::vector<tcp::endpoint> others {};
+    const auto family {endpoints.front().protocol()};
+    for (const auto& endpoint: endpoints) {
+        if (endpoint.protocol() == family) {
+            endpoints_.push_back(endpoint);
+        } else {
+            others.push_back(endpoint);
+        }
+    }
+    for (std::size_t idx {0}; idx < others.size(); ++idx) {
+        const auto pos {std::min(2 * idx + 1, endpoints_.size())};
+        endpoints_.insert(endpoints_.begin() + pos, others[idx]);
+    }
+    attempts_.clear();
+    nextEndpoint_ = 0;
+    nPendingAttempts_ = 0;
+    attemptError_ = {};
+    StartAttempt();
+  }
+
+  void WebSocketClient::StartAttempt()
+  {
+    NM_LOG_DEBUG("About to call async_connect");
+    const auto& endpoint {endpoints_[nextEndpoint_++]};
+    attempts_.push_back(
+        std::make_unique<TcpStream>(ws_.get_executor())
+    );
+    auto& attempt {*attempts_.back()};
+    ++nPendingAttempts_;
+    attempt.expires_after(options_.connectTimeout);
+    attempt.async_connect(endpoint,
+        [this, cycle = cycle_, idx = attempts_.size() - 1](auto ec) {
+            OnAttempt(cycle, idx, ec);
+        });
+
+    // Do not wait for the full timeout of a stalled attempt before trying
+    // the next address.
+    if (nextEndpoint_ < endpoints_.size()) {
+        attemptTimer_.expires_after(options_.attemptDelay);
+        attemptTimer_.async_wait([this, cycle = cycle_](auto ec) {
+            if (!ec && cycle == cycle_ &&
+                nextEndpoint_ < endpoints_.size()) {
+                StartAttempt();
+            }
         });
+    }
   }
 
-  void WebSocketClient::OnConnect(const boost::system::error_code& ec)
+  void WebSocketClient::OnAttempt(
+    std::uint64_t cycle,
+    std::size_t attempt,
+    const boost::system::error_code& ec
+  )
   {
+    if (cycle != cycle_) {
+        return;
+    }
+    --nPendingAttempts_;
     if (ec) {
-        if (OnConnect_) {
-            OnConnect_(ec);
+        NM_LOG_DEBUG("Connection attempt failed", ec);
+        attemptError_ = ec;
+        if (nextEndpoint_ < endpoints_.size()) {
+            StartAttempt();
+        } else if (nPendingAttempts_ == 0) {
+            // The addresses may be stale: resolve again next time.
+            DnsCache::Get().Invalidate(url_, port_);
+            OnConnectFailed(attemptError_);
         }
         return;
     }
 
-    std::cout << "About to do handshake" << std::endl;
+    // We have a winner. Silence the other attempts and move the socket
+    // under the WebSocket stream, which is reused as is.
+    EndPhase(connectTime_);
+    ++cycle_;
+    attemptTimer_.cancel();
+    auto& lowest {boost::beast::get_lowest_layer(ws_)};
+    lowest.close();
+    lowest.socket() = attempts_[attempt]->release_socket();
+    lowest.expires_never();
+    attempts_.clear();
+    rBuffer_.clear();
+
+    NM_LOG_DEBUG("About to do handshake");
     // Step 3. Perform WebSocket handshake
     ws_.async_handshake(url_, endpoint_,
-        [this](auto ec) {
-            if (OnConnect_) {
-                OnConnect_(ec);  // Here we calling OnConnect to send message.
+        [this, cycle = cycle_](auto ec) {
+            if (cycle == cycle_) {
+                OnHandshake(ec);
             }
+        });
+  }
 
-            // Start listening for messages
-            ListenToIncomingMessage(ec); // Here we listening recursively for incoming messages.
+  void WebSocketClient::OnHandshake(const boost::system::error_code& ec)
+  {
+    if (ec) {
+        OnConnectFailed(ec);
+        return;
+    }
+    EndPhase(handshakeTime_);
+    state_ = State::Connected;
+    nFailures_ = 0;
+    if (hasConnected_) {
+        ++nReconnects_;
+    }
+    hasConnected_ = true;
+    Increment(nConnects_);
+
+    if (OnConnect_) {
+        RunCallback([&]() {
+            OnConnect_(ec);  // Here we calling OnConnect to send message.
         });
+    }
+
+    // Start listening for messages, and send what was queued while we were
+    // not connected. In pull mode the caller reads when it is ready.
+    if (!pullMode_) {
+        ListenToIncomingMessage();
+    }
+    if (!writing_) {
+        WriteNext();
+    }
   }
 
-  void WebSocketClient::ListenToIncomingMessage(
-    const boost::system::error_code& ec
-  )
-  { 
-    // Stop processing messages if the connection has been aborted.
-    if (ec == boost::asio::error::operation_aborted) {
-        // We check the closed_ flag to avoid notifying the user twice.
-        if (OnDisconnect_   && ! closed_) {
-            OnDisconnect_ (ec);
-        }
+  void WebSocketClient::OnConnectFailed(const boost::system::error_code& ec)
+  {
+    const auto& policy {options_.reconnect};
+    if (policy.enabled &&
+        (policy.maxAttempts == 0 || nFailures_ < policy.maxAttempts)) {
+        ScheduleReconnect();
         return;
     }
 
+    NM_LOG_ERROR("Could not connect", ec);
+    state_ = State::Disconnected;
+    if (OnConnect_) {
+        RunCallback([&]() {
+            OnConnect_(ec);
+        });
+    }
+    if (!writing_) {
+        WriteNext();
+    }
+  }
+
+  void WebSocketClient::OnDisconnected(const boost::system::error_code& ec)
+  {
+    // Close() reports on its own.
+    if (state_ != State::Connected) {
+        return;
+    }
+    if (ec == boost::beast::websocket::error::closed) {
+        NM_LOG_DEBUG("Connection closed by the server");
+    } else {
+        NM_LOG_WARNING("Connection lost", ec);
+    }
+    state_ = options_.reconnect.enabled && !pullMode_ ? State::Connecting :
+                                                        State::Disconnected;
+    Increment(nDisconnects_);
+    if (OnDisconnect_) {
+        RunCallback([&]() {
+            OnDisconnect_(ec);
+        });
+    }
+    if (state_ == State::Connecting) {
+        ScheduleReconnect();
+    } else if (!writing_) {
+        WriteNext();
+    }
+  }
+
+  void WebSocketClient::ScheduleReconnect()
+  {
+    const auto& policy {options_.reconnect};
+    auto delay {static_cast<double>(policy.initialDelay.count())};
+    const auto maxDelay {static_cast<double>(policy.maxDelay.count())};
+    for (std::size_t idx {0}; idx < nFailures_ && delay < maxDelay; ++idx) {
+        delay *= policy.multiplier;
+    }
+    delay = std::min(delay, maxDelay);
+    std::uniform_real_distribution<double> jitter {1.0 - policy.jitter, 1.0};
+    delay *= jitter(rng_);
+    ++nFailures_;
+
+    reconnectTimer_.expires_after(std::chrono::microseconds {
+        static_cast<std::int64_t>(delay * 1000)
+    });
+    reconnectTimer_.async_wait([this](auto ec) {
+        if (!ec && state_ == State::Connecting) {
+            StartConnect();
+        }
+    });
+  }
+
+  void WebSocketClient::ListenToIncomingMessage()
+  { 
     // Read a message asynchronously. On a successful read, process the message
     // and recursively call this function again to process the next message.
-    ws_.async_read(rBuffer_,
-        [this](auto ec, auto nBytes) {
-            OnRead(ec, nBytes);
-            ListenToIncomingMessage(ec);
-        }
-    );
+    // Any error ends the connection.
+    Increment(nReadLoops_);
+    // A message already buffered by the stream is decompressed right here,
+    // so time the call and not just its completion.
+    ws_.next_layer().Timed([this]() {
+        ws_.async_read(rBuffer_,
+            [this, cycle = cycle_](auto ec, auto nBytes) {
+                if (cycle != cycle_) {
+                    return;
+                }
+                if (ec) {
+                    OnDisconnected(ec);
+                    return;
+                }
+                OnRead(ec, nBytes);
+                ListenToIncomingMessage();
+            }
+        );
+    });
   }
 
   void WebSocketClient::OnRead(
@@ -121,55 +402,371 @@ namespace NetworkMonitor
     if (ec) {
         return;
     }
+    Increment(nReceived_);
+    Increment(rawBytesReceived_, nBytes);
+
+    // Zero-copy path: hand out a view into the flat_buffer, which is always
+    // contiguous, and only consume the bytes once the user is done with them.
+    // Note: This call is synchronous and will block the WebSocket strand.
+    if (OnMessageView_) {
+        const auto data {rBuffer_.data()};
+        RunCallback([&]() {
+            OnMessageView_(ec, boost::beast::string_view {
+                static_cast<const char*>(data.data()), data.size()
+            });
+        });
+        rBuffer_.consume(nBytes);
+        return;
+    }
 
     // Parse the message and forward it to the user callback.
     // Note: This call is synchronous and will block the WebSocket strand.
     std::string message {boost::beast::buffers_to_string(rBuffer_.data())};
     rBuffer_.consume(nBytes);
     if (OnMessage_) {
-        OnMessage_(ec, std::move(message));
+        RunCallback([&]() {
+            OnMessage_(ec, std::move(message));
+        });
     }
   }
 
-  void WebSocketClient::Send(const std::string& message,
+  bool WebSocketClient::BeginPull()
+  {
+    if (!pullMode_ || state_ != State::Connected) {
+        return false;
+    }
+    Increment(nReadLoops_);
+    return true;
+  }
+
+  void WebSocketClient::OnPull(
+    const boost::system::error_code& ec,
+    std::size_t nBytes,
+    std::string& message
+  )
+  {
+    // Unlike the read loop, a read that fails because of Close() still
+    // reports the error: the caller is waiting for it.
+    if (ec) {
+        OnDisconnected(ec);
+        return;
+    }
+    Increment(nReceived_);
+    Increment(rawBytesReceived_, nBytes);
+    message = boost::beast::buffers_to_string(rBuffer_.data());
+    rBuffer_.consume(nBytes);
+  }
+
+  bool WebSocketClient::Send(std::string message,
                            std::function<void(boost::system::error_code)> onSend) {
-    ws_.async_write(boost::asio::buffer(message),
-        [onSend](auto ec, auto /*bytes_transferred*/) {
-            // Dispatch the user callback synchronously, blocking the strand
-            if (onSend) {
-                onSend(ec);  // User callback for handling message sent status
+    if (!ReserveQueueSpace(message.size())) {
+        if (onSend) {
+            onSend(boost::asio::error::no_buffer_space);
+        }
+        return false;
+    }
+
+    boost::asio::post(ws_.get_executor(),
+        [this, message = std::move(message), onSend = std::move(onSend)]() mutable {
+            QueueWrite(std::move(message), std::move(onSend));
+        }
+    );
+    return true;
+  }
+
+  bool WebSocketClient::ReserveQueueSpace(std::size_t nBytes)
+  {
+    // Reserve room in the queue before going to the strand, so that the
+    // backpressure check works from any thread without locking.
+    const auto queued {queuedBytes_.fetch_add(nBytes) + nBytes};
+    if (queued > highWaterMark_ && queued != nBytes) {
+        queuedBytes_.fetch_sub(nBytes);
+        return false;
+    }
+    return true;
+  }
+
+  void WebSocketClient::QueueWrite(
+    std::string message,
+    std::function<void (boost::system::error_code)> onSend)
+  {
+    wQueue_.push_back({std::move(message), std::move(onSend)});
+    UpdateQueueDepth();
+    if (!writing_) {
+        WriteNext();
+    }
+  }
+
+  WebSocketClient::WritePath WebSocketClient::BeginWrite(std::string& message)
+  {
+    if (state_ == State::Disconnected || state_ == State::Closed) {
+        queuedBytes_.fetch_sub(message.size());
+        return WritePath::Fail;
+    }
+    if (state_ != State::Connected || writing_ || !wQueue_.empty()) {
+        return WritePath::Queue;
+    }
+
+    // The message still goes through the queue, which keeps it alive and
+    // in order, but the caller waits on the write itself. OnWrite() sees
+    // no callback and moves on to the rest of the queue.
+    wQueue_.push_back({std::move(message), nullptr});
+    UpdateQueueDepth();
+    writing_ = true;
+    return WritePath::Direct;
+  }
+
+  void WebSocketClient::SetHighWaterMark(std::size_t bytes)
+  {
+    highWaterMark_ = bytes;
+  }
+
+  std::size_t WebSocketClient::GetQueuedBytes() const
+  {
+    return queuedBytes_;
+  }
+
+  std::size_t WebSocketClient::GetReconnectCount() const
+  {
+    return nReconnects_;
+  }
+
+  WebSocketClient::Strand WebSocketClient::GetExecutor()
+  {
+    return ws_.get_executor();
+  }
+
+  WebSocketClientMetrics WebSocketClient::GetMetrics() const
+  {
+    WebSocketClientMetrics metrics {};
+    metrics.traffic = GetStats();
+    metrics.readLoopIterations = nReadLoops_.load(std::memory_order_relaxed);
+    metrics.connects = nConnects_.load(std::memory_order_relaxed);
+    metrics.disconnects = nDisconnects_.load(std::memory_order_relaxed);
+    metrics.reconnects = nReconnects_;
+    metrics.queuedMessages = queueDepth_.load(std::memory_order_relaxed);
+    metrics.queuedBytes = queuedBytes_;
+    metrics.maxQueuedMessages = maxQueueDepth_.load(std::memory_order_relaxed);
+    metrics.resolveTime = resolveTime_.Snapshot();
+    metrics.connectTime = connectTime_.Snapshot();
+    metrics.handshakeTime = handshakeTime_.Snapshot();
+    metrics.callbackTime = callbackTime_.Snapshot();
+    return metrics;
+  }
+
+  WebSocketClientStats WebSocketClient::GetStats() const
+  {
+    const auto& stream {ws_.next_layer()};
+    WebSocketClientStats stats {};
+    stats.messagesSent = nSent_.load(std::memory_order_relaxed);
+    stats.messagesReceived = nReceived_.load(std::memory_order_relaxed);
+    stats.rawBytesSent = rawBytesSent_.load(std::memory_order_relaxed);
+    stats.rawBytesReceived = rawBytesReceived_.load(std::memory_order_relaxed);
+    stats.wireBytesSent = stream.GetBytesWritten();
+    stats.wireBytesReceived = stream.GetBytesRead();
+    stats.cpuTime = stream.GetCpuTime();
+    return stats;
+  }
+
+  void WebSocketClient::EndPhase(AtomicHistogram& phaseTime)
+  {
+    phaseTime.Record(NanosecondsSince(phaseStart_));
+    phaseStart_ = std::chrono::steady_clock::now();
+  }
+
+  void WebSocketClient::UpdateQueueDepth()
+  {
+    const auto depth {static_cast<std::uint64_t>(wQueue_.size())};
+    queueDepth_.store(depth, std::memory_order_relaxed);
+    if (depth > maxQueueDepth_.load(std::memory_order_relaxed)) {
+        maxQueueDepth_.store(depth, std::memory_order_relaxed);
+    }
+  }
+
+  template <typename Callback>
+  void WebSocketClient::RunCallback(Callback&& callback)
+  {
+    // The strand is blocked for as long as the callback runs. Its CPU time
+    // is not the connection's own, so the stream leaves it out.
+    auto& stream {ws_.next_layer()};
+    if (!options_.callbackMetrics) {
+        stream.Untimed(callback);
+        return;
+    }
+    const auto start {std::chrono::steady_clock::now()};
+    stream.Untimed(callback);
+    callbackTime_.Record(NanosecondsSince(start));
+  }
+
+  void WebSocketClient::WriteNext()
+  {
+    if (wQueue_.empty()) {
+        writing_ = false;
+        return;
+    }
+    if (state_ != State::Connected) {
+        writing_ = false;
+        if (state_ == State::Connecting) {
+            // Sent once the connection is up.
+            return;
+        }
+        // Nothing will bring the connection back.
+        auto failed {std::move(wQueue_)};
+        wQueue_.clear();
+        UpdateQueueDepth();
+        for (auto& write: failed) {
+            queuedBytes_.fetch_sub(write.message.size());
+            if (write.onSend) {
+                RunCallback([&]() {
+                    write.onSend(boost::asio::error::not_connected);
+                });
             }
         }
+        return;
+    }
+    writing_ = true;
+
+    // When small messages are waiting behind each other we cork the stream:
+    // their frames are collected in memory and leave in a single write.
+    auto& stream {ws_.next_layer()};
+    const auto& next {wQueue_.front()};
+    if (!stream.IsCorked() &&
+        wQueue_.size() > 1 &&
+        next.message.size() <= kCoalesceMessageBytes) {
+        stream.Cork();
+    }
+
+    // The message is compressed, at least its first chunk, before
+    // async_write() returns.
+    stream.Timed([this, &next]() {
+        ws_.async_write(boost::asio::buffer(next.message),
+            [this](auto ec, auto /*bytes_transferred*/) {
+                OnWrite(ec);
+            }
+        );
+    });
+  }
+
+  void WebSocketClient::OnWrite(const boost::system::error_code& ec)
+  {
+    auto& stream {ws_.next_layer()};
+    auto done {std::move(wQueue_.front())};
+    wQueue_.pop_front();
+    UpdateQueueDepth();
+    queuedBytes_.fetch_sub(done.message.size());
+    if (!ec) {
+        Increment(nSent_);
+        Increment(rawBytesSent_, done.message.size());
+    }
+
+    if (!stream.IsCorked()) {
+        // Dispatch the user callback synchronously, blocking the strand
+        if (done.onSend) {
+            RunCallback([&]() {
+                done.onSend(ec);  // User callback for handling message sent status
+            });
+        }
+        WriteNext();
+        return;
+    }
+
+    // The frame is only in our buffer so far. Report it once it is flushed.
+    wBatch_.push_back(std::move(done.onSend));
+    const bool keepBatching {
+        !ec &&
+        !wQueue_.empty() &&
+        wQueue_.front().message.size() <= kCoalesceMessageBytes &&
+        stream.GetBufferedBytes() < kCoalesceBatchBytes
+    };
+    if (keepBatching) {
+        WriteNext();
+        return;
+    }
+    stream.AsyncFlush(
+        [this](auto ec) {
+            OnFlush(ec);
+        }
     );
   }
 
+  void WebSocketClient::OnFlush(const boost::system::error_code& ec)
+  {
+    // Send() only posts to the strand, so the callbacks cannot touch the
+    // batch while we walk it.
+    for (auto& onSend: wBatch_) {
+        if (onSend) {
+            RunCallback([&]() {
+                onSend(ec);
+            });
+        }
+    }
+    wBatch_.clear();
+    WriteNext();
+  }
+
   void WebSocketClient::Close(
     std::function<void(boost::system::error_code)> onClose) {
-    
-    // Set the closed_ flag to true to indicate we're closing the connection
-    closed_ = true;
-
-    // Store the onClose callback for later use
-  //  if (onClose) {
-  //      OnDisconnect_ = std::move(onClose);
-  //  }
-
-    // Initiate the WebSocket close handshake
-    ws_.async_close(boost::beast::websocket::close_code::normal,
-        [this](boost::system::error_code ec) {
-            // Handle the result of the close operation
-        // Call the user-provided callback to notify that the WebSocket has been closed
-        if (OnDisconnect_) {
-            OnDisconnect_(ec);  // Pass the error code to the user's callback
+
+    // Hop onto the strand: the stream is not thread safe and Close() may be
+    // called from anywhere.
+    boost::asio::post(ws_.get_executor(),
+        [this, onClose = std::move(onClose)]() mutable {
+            // Stop whatever the previous state was doing: pending connection
+            // attempts, a scheduled reconnection, the read loop.
+            const auto previous {state_};
+            state_ = State::Closed;
+            ++cycle_;
+            resolver_.cancel();
+            attemptTimer_.cancel();
+            reconnectTimer_.cancel();
+            attempts_.clear();
+
+            if (previous != State::Connected) {
+                boost::system::error_code ignored {};
+                boost::beast::get_lowest_layer(ws_).socket().close(ignored);
+                // A caller waiting in AsyncConnect() would never hear back.
+                if (pullMode_ && previous == State::Connecting &&
+                    OnConnect_) {
+                    auto onConnect {std::move(OnConnect_)};
+                    OnConnect_ = nullptr;
+                    onConnect(boost::asio::error::operation_aborted);
+                }
+                if (onClose) {
+                    onClose(boost::asio::error::not_connected);
+                }
+                if (!writing_) {
+                    WriteNext();
+                }
+                return;
+            }
+
+            // Initiate the WebSocket close handshake
+            ws_.async_close(boost::beast::websocket::close_code::normal,
+                [this, onClose = std::move(onClose)](auto ec) {
+                    if (onClose) {
+                        onClose(ec);
+                    }
+                    // Notify the user that the WebSocket has been closed
+                    Increment(nDisconnects_);
+                    if (OnDisconnect_) {
+                        RunCallback([&]() {
+                            OnDisconnect_(ec);
+                        });
+                    }
+                    if (!writing_) {
+                        WriteNext();
+                    }
+                }
+            );
         }
-        });
+    );
 }
 
 void NetworkMonitor::WebSocketClient::OnClose(const boost::system::error_code& ec) {
     if (ec) {
-        std::cerr << "Error closing WebSocket: " << ec.message() << std::endl;
+        NM_LOG_ERROR("Error closing WebSocket", ec);
     } else {
-        std::cout << "WebSocket closed successfully." << std::endl;
+        NM_LOG_INFO("WebSocket closed successfully.");
     }
 
     // Call the user-provided callback to notify that the WebSocket has been closed
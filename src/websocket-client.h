@@ -1,32 +1,240 @@
+#ifndef NETWORK_MONITOR_WEBSOCKET_CLIENT_H
+#define NETWORK_MONITOR_WEBSOCKET_CLIENT_H
 
 #include <iostream>
+#include "coalescing-stream.h"
+#include "compression-options.h"
+#include "histogram.h"
 #include "logging.h"
 
 #include <boost/asio.hpp>
 #include <boost/system/error_code.hpp>
 #include <boost/beast/websocket.hpp> // Correct WebSocket header
 #include <boost/beast/core.hpp> // For flat_buffer and tcp_stream
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <iomanip>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 using tcp = boost::asio::ip::tcp;
 
 namespace NetworkMonitor {
 
+/*! \brief When and how often a WebSocketClient reconnects.
+ *
+ *  The n-th consecutive attempt waits
+ *  min(maxDelay, initialDelay * multiplier^n), shortened by a random
+ *  fraction of up to `jitter` so that clients that lost the same server do
+ *  not all come back at the same instant.
+ */
+struct ReconnectPolicy {
+    bool enabled {false};
+    std::chrono::milliseconds initialDelay {10};
+    std::chrono::milliseconds maxDelay {5000};
+    double multiplier {2.0};
+    double jitter {0.5};
+
+    /*! \brief Give up after this many consecutive failures. 0: never.
+     */
+    std::size_t maxAttempts {0};
+};
+
+/*! \brief Connection settings of a WebSocketClient.
+ */
+struct WebSocketClientOptions {
+    ReconnectPolicy reconnect {};
+
+    /*! \brief How long resolved endpoints stay in the DnsCache. 0 disables
+     *         the cache.
+     */
+    std::chrono::milliseconds dnsTtl {30000};
+
+    /*! \brief Upper bound for each TCP connection attempt.
+     */
+    std::chrono::milliseconds connectTimeout {3000};
+
+    /*! \brief Head start of each connection attempt before the next
+     *         address is tried in parallel (the Happy Eyeballs "connection
+     *         attempt delay", RFC 8305).
+     */
+    std::chrono::milliseconds attemptDelay {250};
+
+    /*! \brief Upper bound for the WebSocket handshake.
+     */
+    std::chrono::milliseconds handshakeTimeout {5000};
+
+    /*! \brief permessage-deflate settings offered to the server.
+     */
+    CompressionOptions compression {};
+
+    /*! \brief Measure the CPU time of the connection, see
+     *         WebSocketClientStats::cpuTime. This reads the thread CPU clock
+     *         a few times per message.
+     */
+    bool cpuStats {false};
+
+    /*! \brief Time every user callback, see
+     *         WebSocketClientMetrics::callbackTime. This reads the steady
+     *         clock twice per callback.
+     */
+    bool callbackMetrics {true};
+};
+
+/*! \brief Traffic counters of a WebSocketClient.
+ *
+ *  Raw bytes are message payloads as the application sees them; wire bytes
+ *  are what went through the socket, so they include the HTTP upgrade, frame
+ *  headers and control frames, and are compressed if the server accepted
+ *  permessage-deflate.
+ */
+struct WebSocketClientStats {
+    std::uint64_t messagesSent {0};
+    std::uint64_t messagesReceived {0};
+    std::uint64_t rawBytesSent {0};
+    std::uint64_t rawBytesReceived {0};
+    std::uint64_t wireBytesSent {0};
+    std::uint64_t wireBytesReceived {0};
+
+    /*! \brief CPU time spent by the connection on its messages: framing,
+     *         masking and compression, not counting the user callbacks.
+     *         Approximate, and 0 unless WebSocketClientOptions::cpuStats is
+     *         set.
+     */
+    std::chrono::nanoseconds cpuTime {0};
+};
+
+/*! \brief Everything a WebSocketClient measures about itself, as returned by
+ *         WebSocketClient::GetMetrics().
+ *
+ *  Counters are totals since construction. Durations are in nanoseconds.
+ */
+struct WebSocketClientMetrics {
+    WebSocketClientStats traffic {};
+
+    /*! \brief Messages read by the read loop, or errors that ended it.
+     */
+    std::uint64_t readLoopIterations {0};
+
+    std::uint64_t connects {0};
+    std::uint64_t disconnects {0};
+    std::uint64_t reconnects {0};
+
+    /*! \brief Write queue depth now, and the highest it has been.
+     */
+    std::uint64_t queuedMessages {0};
+    std::uint64_t queuedBytes {0};
+    std::uint64_t maxQueuedMessages {0};
+
+    /*! \brief From Connect() to the server address, from the address to the
+     *         TCP connection, and from there to the end of the WebSocket
+     *         handshake, for every successful connection.
+     */
+    Histogram resolveTime {AtomicHistogram::kDefaultSubBucketBits};
+    Histogram connectTime {AtomicHistogram::kDefaultSubBucketBits};
+    Histogram handshakeTime {AtomicHistogram::kDefaultSubBucketBits};
+
+    /*! \brief Time spent in user callbacks, during which the connection
+     *         cannot make progress.
+     */
+    Histogram callbackTime {AtomicHistogram::kDefaultSubBucketBits};
+};
+
 /*! \brief Client to connect to a WebSocket server over plain TCP.
  */
 class WebSocketClient {
+public:
+    /*! \brief The executor the connection runs on.
+     *
+     *  A concrete strand type rather than any_io_executor: Asio takes a work
+     *  guard on the executor for every operation, and any_io_executor has
+     *  to allocate to hold a strand.
+     */
+    using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
 
 private:
+    using TcpStream = boost::beast::basic_stream<tcp, Strand>;
+
     std::string url_ {};
     std::string endpoint_ {};
     std::string port_ {};
+    WebSocketClientOptions options_ {};
 
     // we leave these uninitialized because they do not support default constructor
+    boost::beast::websocket::stream<
+        CoalescingStream<TcpStream>
+    > ws_;
     boost::asio::ip::tcp::resolver resolver_;
-    boost::beast::websocket::stream<boost::beast::tcp_stream> ws_;
     boost::beast::flat_buffer rBuffer_ {};
 
-    bool closed_ {true};
+    // Everything below runs on the strand of ws_, like the stream itself.
+    enum class State {
+        Disconnected,
+        Connecting,
+        Connected,
+        Closed,
+    };
+    State state_ {State::Disconnected};
+
+    // Set by AsyncConnect(): the caller pulls messages with AsyncRead()
+    // instead of the read loop pushing them, and reconnects by itself.
+    bool pullMode_ {false};
+
+    // Bumped whenever the pending operations of the previous connection
+    // attempt must be ignored.
+    std::uint64_t cycle_ {0};
+
+    // Happy Eyeballs: one TCP stream per address being tried. The first one
+    // to connect hands its socket over to ws_.
+    std::vector<tcp::endpoint> endpoints_ {};
+    std::vector<std::unique_ptr<TcpStream>> attempts_ {};
+    std::size_t nextEndpoint_ {0};
+    std::size_t nPendingAttempts_ {0};
+    boost::system::error_code attemptError_ {};
+    boost::asio::steady_timer attemptTimer_;
+
+    boost::asio::steady_timer reconnectTimer_;
+    std::size_t nFailures_ {0};
+    bool hasConnected_ {false};
+    std::atomic<std::size_t> nReconnects_ {0};
+    std::minstd_rand rng_;
+
+    // Outbound messages. The queue owns the strings so that callers do not
+    // have to keep them alive, and only the front one is ever being written.
+    struct PendingWrite {
+        std::string message;
+        std::function<void(boost::system::error_code)> onSend;
+    };
+    std::deque<PendingWrite> wQueue_ {};
+    std::vector<std::function<void(boost::system::error_code)>> wBatch_ {};
+    bool writing_ {false};
+    std::atomic<std::size_t> queuedBytes_ {0};
+    std::atomic<std::size_t> highWaterMark_ {kDefaultHighWaterMark};
+
+    // Payload counters. The wire counters live in the coalescing stream.
+    std::atomic<std::uint64_t> nSent_ {0};
+    std::atomic<std::uint64_t> nReceived_ {0};
+    std::atomic<std::uint64_t> rawBytesSent_ {0};
+    std::atomic<std::uint64_t> rawBytesReceived_ {0};
+
+    // Metrics, written on the strand and read from anywhere.
+    std::atomic<std::uint64_t> nReadLoops_ {0};
+    std::atomic<std::uint64_t> nConnects_ {0};
+    std::atomic<std::uint64_t> nDisconnects_ {0};
+    std::atomic<std::uint64_t> queueDepth_ {0};
+    std::atomic<std::uint64_t> maxQueueDepth_ {0};
+    AtomicHistogram resolveTime_ {};
+    AtomicHistogram connectTime_ {};
+    AtomicHistogram handshakeTime_ {};
+    AtomicHistogram callbackTime_ {};
+    std::chrono::steady_clock::time_point phaseStart_ {};
 
     // Callback handlers
     /*
@@ -36,6 +244,8 @@ private:
     */
     std::function<void(boost::system::error_code)> OnConnect_;
     std::function<void(boost::system::error_code, std::string&&)> OnMessage_;
+    std::function<void(boost::system::error_code,
+                       boost::beast::string_view)> OnMessageView_;
     std::function<void(boost::system::error_code)> OnDisconnect_;
     
     /*
@@ -43,13 +253,114 @@ private:
         OnConnect for handshake. There is nothing for application to do here, its websocket-client's internal
         functionality for successful connection and communication. 
     */
-    void OnResolve(const boost::system::error_code& ec, tcp::resolver::results_type results);
-    void OnConnect(const boost::system::error_code& ec);
-    void ListenToIncomingMessage(const boost::system::error_code& ec);
+    void StartConnect();
+    void OnResolve(const boost::system::error_code& ec, std::vector<tcp::endpoint> endpoints);
+    void StartAttempt();
+    void OnAttempt(std::uint64_t cycle, std::size_t attempt,
+                   const boost::system::error_code& ec);
+    void OnHandshake(const boost::system::error_code& ec);
+    void OnConnectFailed(const boost::system::error_code& ec);
+    void OnDisconnected(const boost::system::error_code& ec);
+    void ScheduleReconnect();
+    void ListenToIncomingMessage();
     void OnRead(const boost::system::error_code& ec, std::size_t nBytes);
     void OnClose(const boost::system::error_code& ec);
+    void WriteNext();
+    void OnWrite(const boost::system::error_code& ec);
+    void OnFlush(const boost::system::error_code& ec);
+    void EndPhase(AtomicHistogram& phaseTime);
+    void UpdateQueueDepth();
+    template <typename Callback>
+    void RunCallback(Callback&& callback);
+    void StartPullConnect(
+        std::function<void (boost::system::error_code)> onConnect
+    );
+    bool BeginPull();
+    void OnPull(const boost::system::error_code& ec, std::size_t nBytes,
+                std::string& message);
+    bool ReserveQueueSpace(std::size_t nBytes);
+    void QueueWrite(std::string message,
+                    std::function<void (boost::system::error_code)> onSend);
+    enum class WritePath {
+        Direct,  // Nothing else is being written: write it now.
+        Queue,   // Queue it behind the pending writes.
+        Fail,    // Not connected, and not about to be.
+    };
+    WritePath BeginWrite(std::string& message);
+
+    // A completion handler of the Async* functions, with work on its
+    // executor for as long as the operation is pending.
+    template <typename Handler>
+    class PendingOp {
+    public:
+        PendingOp(
+            Handler&& handler,
+            const Strand& fallback
+        ) : work_ {boost::asio::make_work_guard(handler, fallback)},
+            handler_ {std::move(handler)}
+        {
+        }
+
+        // Run the handler on its executor. An immediate result, one that
+        // was not waited for, is posted so that the handler never runs
+        // inside the initiating function.
+        template <typename... Args>
+        void Complete(bool immediate, Args&&... args)
+        {
+            auto executor {work_.get_executor()};
+            auto invoke {[handler = std::move(handler_),
+                          ...args = std::forward<Args>(args)]() mutable {
+                std::move(handler)(std::move(args)...);
+            }};
+            work_.reset();
+            if (immediate) {
+                boost::asio::post(executor, std::move(invoke));
+            } else {
+                boost::asio::dispatch(executor, std::move(invoke));
+            }
+        }
+
+    private:
+        boost::asio::executor_work_guard<
+            boost::asio::associated_executor_t<Handler, Strand>
+        > work_;
+        Handler handler_;
+    };
+
+    template <typename Handler>
+    PendingOp<std::decay_t<Handler>> MakePendingOp(Handler&& handler)
+    {
+        return {std::forward<Handler>(handler), ws_.get_executor()};
+    }
+
+    // Hand a pending operation to the std::function based machinery: the
+    // connection, queued writes and Close(). It costs an allocation, so the
+    // per-message paths only take it when they have to.
+    template <typename Handler>
+    std::function<void (boost::system::error_code)> ToCallback(
+        PendingOp<Handler>&& op
+    )
+    {
+        auto shared {std::make_shared<PendingOp<Handler>>(std::move(op))};
+        return [shared](auto ec) {
+            shared->Complete(false, ec);
+        };
+    }
 
 public:
+    /*! \brief Default limit for the bytes waiting in the outbound queue.
+     */
+    static constexpr std::size_t kDefaultHighWaterMark {16 * 1024 * 1024};
+
+    /*! \brief Messages up to this size are batched with their neighbours
+     *         into a single write on the socket.
+     */
+    static constexpr std::size_t kCoalesceMessageBytes {4096};
+
+    /*! \brief Upper bound for the bytes sent in one batched write.
+     */
+    static constexpr std::size_t kCoalesceBatchBytes {64 * 1024};
+
     /*! \brief Construct a WebSocket client.
      *
      *  \note This constructor does not initiate a connection.
@@ -60,12 +371,15 @@ public:
      *  \param port     The port on the server.
      *  \param ioc      The io_context object. The user takes care of calling
      *                  ioc.run().
+     *  \param options  Timeouts, DNS caching, reconnection policy and
+     *                  compression.
      */
     WebSocketClient(
         const std::string& url,
         const std::string& endpoint,
         const std::string& port,
-        boost::asio::io_context& ioc
+        boost::asio::io_context& ioc,
+        WebSocketClientOptions options = {}
     );
 
     /*! \brief Destructor.
@@ -73,6 +387,15 @@ public:
     ~WebSocketClient();
 
     /*! \brief Connect to the server.
+     *
+     *  The resolved addresses are tried in parallel with a short stagger
+     *  (Happy Eyeballs); the first one to accept the connection wins.
+     *
+     *  With a reconnection policy, a lost connection is re-established in the
+     *  background: onDisconnect is called when it drops and onConnect again
+     *  once it is back. Failed attempts are retried quietly; onConnect only
+     *  sees an error when the policy gives up. Messages sent in the meantime
+     *  wait in the outbound queue.
      *
      *  \param onConnect     Called when the connection fails or succeeds.
      *  \param onMessage     Called only when a message is successfully
@@ -88,27 +411,268 @@ public:
         std::function<void (boost::system::error_code)> onDisconnect = nullptr
     );
 
+    /*! \brief Connect to the server and receive messages as read-only views.
+     *
+     *  This is the zero-copy alternative to Connect(). The message is not
+     *  copied out of the receive buffer: the view points straight into it.
+     *
+     *  \param onConnect     Called when the connection fails or succeeds.
+     *  \param onMessage     Called only when a message is successfully
+     *                       received. The view is only valid for the duration
+     *                       of the call; the receive buffer is consumed as
+     *                       soon as the handler returns. Copy the bytes if
+     *                       you need them afterwards.
+     *  \param onDisconnect  Called when the connection is closed by the server
+     *                       or due to a connection error.
+     */
+    void ConnectView(
+        std::function<void (boost::system::error_code)> onConnect = nullptr,
+        std::function<void (boost::system::error_code,
+                            boost::beast::string_view)> onMessage = nullptr,
+        std::function<void (boost::system::error_code)> onDisconnect = nullptr
+    );
+
     /*! \brief Send a text message to the WebSocket server.
      *
-     *  \param message The message to send. The caller must ensure that this
-     *                 string stays in scope until the onSend handler is called.
+     *  Messages are queued and written one at a time, in order. Small
+     *  messages that pile up behind a slow write are sent together.
+     *
+     *  \param message The message to send. The client takes ownership of it.
      *  \param onSend  Called when a message is sent successfully or if it
-     *                 failed to send.
+     *                 failed to send. Called with
+     *                 boost::asio::error::no_buffer_space if the message was
+     *                 rejected because of backpressure.
+     *                 Called with boost::asio::error::not_connected if the
+     *                 connection is gone and is not being re-established.
+     *  \returns false if the queue is above the high-water mark. The message
+     *          is dropped in that case; the caller should slow down.
+     *
+     *  \note This function is thread safe.
      */
-    void Send(
-        const std::string& message,
+    bool Send(
+        std::string message,
         std::function<void (boost::system::error_code)> onSend = nullptr
     );
 
+    /*! \brief Set how many bytes may wait in the outbound queue before Send()
+     *         starts rejecting messages.
+     */
+    void SetHighWaterMark(std::size_t bytes);
+
+    /*! \brief Number of bytes currently waiting in the outbound queue.
+     */
+    std::size_t GetQueuedBytes() const;
+
+    /*! \brief Number of times the connection was re-established after a
+     *         drop.
+     */
+    std::size_t GetReconnectCount() const;
+
+    /*! \brief Traffic and compression counters since construction.
+     *
+     *  \note This function is thread safe.
+     */
+    WebSocketClientStats GetStats() const;
+
+    /*! \brief Counters and latency histograms since construction.
+     *
+     *  This copies a few KB of histograms: call it to export metrics, not
+     *  on every message.
+     *
+     *  \note This function is thread safe.
+     */
+    WebSocketClientMetrics GetMetrics() const;
+
     /*! \brief Close the WebSocket connection.
+     *
+     *  Also stops any reconnection in progress.
      *
      *  \param onClose Called when the connection is closed, successfully or
-     *                 not.
+     *                 not, before the onDisconnect callback given to
+     *                 Connect(). Called with
+     *                 boost::asio::error::not_connected if there was no
+     *                 connection to close.
+     *
+     *  \note This function is thread safe.
      */
     void Close(
         std::function<void (boost::system::error_code)> onClose = nullptr
     );
+
+    /*! \brief The strand the connection runs on.
+     *
+     *  A coroutine spawned on it drives the Async* functions without a hop
+     *  between executors for each operation. Declare it as
+     *  boost::asio::awaitable<T, Strand> and await with
+     *  boost::asio::use_awaitable_t<Strand> to also save wrapping the strand
+     *  in an any_io_executor, which allocates.
+     */
+    Strand GetExecutor();
+
+    /*! \brief Connect to the server, for a caller that pulls messages with
+     *         AsyncRead() instead of receiving them in callbacks.
+     *
+     *  The Async* functions take any Asio completion token. With
+     *  boost::asio::use_awaitable, in a coroutine:
+     *
+     *      co_await client.AsyncConnect(boost::asio::use_awaitable);
+     *      co_await client.AsyncSend("hello", boost::asio::use_awaitable);
+     *      auto message {co_await client.AsyncRead(boost::asio::use_awaitable)};
+     *
+     *  The reconnection policy applies to the connection attempts. A
+     *  connection lost afterwards is reported by AsyncRead() and not
+     *  re-established: call AsyncConnect() again.
+     *
+     *  \param token Completes with (boost::system::error_code), as the
+     *               onConnect callback of Connect(). Closing the client
+     *               while it connects completes it with
+     *               boost::asio::error::operation_aborted.
+     */
+    template <typename ConnectToken>
+    auto AsyncConnect(ConnectToken&& token)
+    {
+        return boost::asio::async_initiate<
+            ConnectToken, void (boost::system::error_code)
+        >(
+            [this](auto&& handler) {
+                StartPullConnect(ToCallback(MakePendingOp(
+                    std::forward<decltype(handler)>(handler)
+                )));
+            },
+            token
+        );
+    }
+
+    /*! \brief Read the next message, after AsyncConnect().
+     *
+     *  Messages are read straight into the completion: there is no
+     *  callback and no read loop in between. Only one read may be pending
+     *  at a time.
+     *
+     *  \param token Completes with (boost::system::error_code, std::string).
+     *               The error is boost::asio::error::not_connected if the
+     *               client is not connected with AsyncConnect(); any other
+     *               error ends the connection.
+     */
+    template <typename ReadToken>
+    auto AsyncRead(ReadToken&& token)
+    {
+        return boost::asio::async_initiate<
+            ReadToken, void (boost::system::error_code, std::string)
+        >(
+            [this](auto&& handler) {
+                boost::asio::dispatch(ws_.get_executor(),
+                    [this, op = MakePendingOp(
+                        std::forward<decltype(handler)>(handler)
+                    )]() mutable {
+                        if (!BeginPull()) {
+                            op.Complete(true, boost::system::error_code {
+                                boost::asio::error::not_connected
+                            }, std::string {});
+                            return;
+                        }
+                        ws_.next_layer().Timed([&]() {
+                            ws_.async_read(rBuffer_,
+                                [this, op = std::move(op)](
+                                    auto ec, auto nBytes
+                                ) mutable {
+                                    std::string message {};
+                                    OnPull(ec, nBytes, message);
+                                    op.Complete(false, ec,
+                                                std::move(message));
+                                }
+                            );
+                        });
+                    }
+                );
+            },
+            token
+        );
+    }
+
+    /*! \brief Send a text message, as Send() does.
+     *
+     *  When nothing else is being written the message goes straight to the
+     *  socket, with no type-erased callback. Otherwise it joins the
+     *  outbound queue behind the other messages.
+     *
+     *  \param token Completes with (boost::system::error_code) once the
+     *               message is written, with the errors of the onSend
+     *               callback of Send().
+     *
+     *  \note This function is thread safe.
+     */
+    template <typename SendToken>
+    auto AsyncSend(std::string message, SendToken&& token)
+    {
+        return boost::asio::async_initiate<
+            SendToken, void (boost::system::error_code)
+        >(
+            [this](auto&& handler, std::string message) {
+                auto op {MakePendingOp(
+                    std::forward<decltype(handler)>(handler)
+                )};
+                if (!ReserveQueueSpace(message.size())) {
+                    op.Complete(true, boost::system::error_code {
+                        boost::asio::error::no_buffer_space
+                    });
+                    return;
+                }
+                boost::asio::dispatch(ws_.get_executor(),
+                    [this, op = std::move(op),
+                     message = std::move(message)]() mutable {
+                        const auto path {BeginWrite(message)};
+                        if (path == WritePath::Fail) {
+                            op.Complete(true, boost::system::error_code {
+                                boost::asio::error::not_connected
+                            });
+                            return;
+                        }
+                        if (path == WritePath::Queue) {
+                            QueueWrite(std::move(message),
+                                       ToCallback(std::move(op)));
+                            return;
+                        }
+                        ws_.next_layer().Timed([&]() {
+                            ws_.async_write(
+                                boost::asio::buffer(wQueue_.front().message),
+                                [this, op = std::move(op)](
+                                    auto ec, auto /*bytes_transferred*/
+                                ) mutable {
+                                    OnWrite(ec);
+                                    op.Complete(false, ec);
+                                }
+                            );
+                        });
+                    }
+                );
+            },
+            token,
+            std::move(message)
+        );
+    }
+
+    /*! \brief Close the connection, as Close() does.
+     *
+     *  \param token Completes with (boost::system::error_code), as the
+     *               onClose callback of Close().
+     */
+    template <typename CloseToken>
+    auto AsyncClose(CloseToken&& token)
+    {
+        return boost::asio::async_initiate<
+            CloseToken, void (boost::system::error_code)
+        >(
+            [this](auto&& handler) {
+                Close(ToCallback(MakePendingOp(
+                    std::forward<decltype(handler)>(handler)
+                )));
+            },
+            token
+        );
+    }
 };
 
 } // namespace NetworkMonitor
 
+#endif // NETWORK_MONITOR_WEBSOCKET_CLIENT_H